@@ -6,32 +6,139 @@ uniform_Texture(sampler2D, rawAudio_);
 uniform_Texture(sampler2D, fastEWMAfreq_);
 uniform_Texture(sampler2D, slowEWMAfreq_);
 uniform_Texture(sampler2D, glacialEWMAfreq_);
+// Magnitudes of frequencyAudio_ and of the moving averages in dB relative to full scale (a full-scale sine on a bin
+// is 0 dB, whatever the window and its length), floored at -120 dB. Computed by the analyzer, so reading them
+// costs one fetch and no log
+uniform_Texture(sampler2D, frequencyDbAudio_);
+uniform_Texture(sampler2D, fastEWMAfreqDb_);
+uniform_Texture(sampler2D, slowEWMAfreqDb_);
+uniform_Texture(sampler2D, glacialEWMAfreqDb_);
+// Every channel of multi-channel input, one layer per channel. frequencyAudio_ and rawAudio_ are channel 0
+uniform_Texture(sampler2DArray, frequencyAudioChannels_);
+uniform_Texture(sampler2DArray, rawAudioChannels_);
+uniform int audioChannelCount;
+// Magnitudes of a few log-spaced bins of a long-window, short-hop sliding DFT of channel 0, one row per hop
+uniform_Texture(sampler2D, slidingSpectrum_);
+// Perceptual (mel or log spaced) bands of channel 0's spectrum, lowest band first, one row per hop. Each band is
+// the RMS of the bin magnitudes under its triangle, so it is on the same scale as sampleFrequencyMagnitudeAudio
+uniform_Texture(sampler2D, bandAudio_);
+// Constant-Q transform of channel 0 (bins constantQBinsPerOctave to the octave, bin 0 at constantQMinFrequency Hz),
+// one row per hop. Scaled like frequencyAudio_
+uniform_Texture(sampler2D, constantQAudio_);
+uniform float constantQBinsPerOctave;
+uniform float constantQMinFrequency;
 
+// The history textures (everything sampled with a time below) are rings, so only new rows have to be uploaded.
+// The newest row is <name>NewestRow and older ones are below it, wrapping around from row 0 to the next-to-top
+// row; the top row repeats row 0, so filtering between the two still works. historyCoord and historyRow find the
+// row time steps before the newest. The channel arrays go with rawAudio_ and frequencyAudio_
+uniform int rawAudioNewestRow;
+uniform int frequencyAudioNewestRow;
+uniform int frequencyDbAudioNewestRow;
+uniform int slidingSpectrumNewestRow;
+uniform int bandAudioNewestRow;
+uniform int constantQAudioNewestRow;
+
+// Audio clock, in seconds since the stream started: stream time of the newest analyzed block, and that
+// extrapolated to the time of drawing. audioLatency is how long ago (wall clock) the newest block was captured
+uniform float audioStreamTime;
+uniform float audioTime;
+uniform float audioLatency;
+
+// Onset (transient) detection on channel 0, one band per component (x: everything, y: kick drums, z: most
+// instruments and voices, w: cymbals), the first onsetBandCount of them in use. onsetEnvelope jumps to 1 at
+// each onset and decays from there; onsetStrength is how far the last onset beat its threshold (> 1); onsetFlux
+// is the newest spectral flux over its threshold, which an onset has to top
+uniform int onsetBandCount;
+uniform vec4 onsetEnvelope;
+uniform vec4 onsetStrength;
+uniform vec4 onsetFlux;
+
+
+// Texture y coordinate of the row time steps before the newest of a history texture height texels high
+float historyCoord(int newestRow, float height, float invHeight, float time) {
+    return (mod(float(newestRow) - time, height - 1.0) + 0.5) * invHeight;
+}
+
+// The same as a texel row, for texelFetch
+int historyRow(int newestRow, float height, int time) {
+    int rows = int(height) - 1;
+    return (newestRow + rows - time % rows) % rows;
+}
 
 // A bunch of helper methods for sampling from the audio textures and perhaps doing a transform on the data
 float sampleRawAudio(float coord, int time) {
-    return textureLod(rawAudio_buffer, vec2(coord, (rawAudio_size.y - time - 0.5)*rawAudio_invSize.y), 0).x;
+    return textureLod(rawAudio_buffer, vec2(coord, historyCoord(rawAudioNewestRow, rawAudio_size.y, rawAudio_invSize.y, float(time))), 0).x;
 }
 
 vec2 sampleFrequencyAudio(float coord, float time) {
-    return textureLod(frequencyAudio_buffer, vec2(coord, (frequencyAudio_size.y - time - 0.5)*frequencyAudio_invSize.y), 0).xy;
+    return textureLod(frequencyAudio_buffer, vec2(coord, historyCoord(frequencyAudioNewestRow, frequencyAudio_size.y, frequencyAudio_invSize.y, time)), 0).xy;
 }
 
 float sampleFrequencyMagnitudeAudio(float coord, float time) {
     return length(sampleFrequencyAudio(coord, time));
 }
 
+// The same for any channel, 0 <= channel < audioChannelCount
+float sampleRawAudioChannel(float coord, int time, int channel) {
+    return textureLod(rawAudioChannels_buffer, vec3(coord, historyCoord(rawAudioNewestRow, rawAudioChannels_size.y, rawAudioChannels_invSize.y, float(time)), channel), 0).x;
+}
+
+vec2 sampleFrequencyAudioChannel(float coord, float time, int channel) {
+    return textureLod(frequencyAudioChannels_buffer, vec3(coord, historyCoord(frequencyAudioNewestRow, frequencyAudioChannels_size.y, frequencyAudioChannels_invSize.y, time), channel), 0).xy;
+}
+
+float sampleFrequencyMagnitudeAudioChannel(float coord, float time, int channel) {
+    return length(sampleFrequencyAudioChannel(coord, time, channel));
+}
+
+// coord runs from the lowest to the highest tracked bin; hop 0 is the newest
+float sampleSlidingSpectrum(float coord, float hop) {
+    return textureLod(slidingSpectrum_buffer, vec2(coord, historyCoord(slidingSpectrumNewestRow, slidingSpectrum_size.y, slidingSpectrum_invSize.y, hop)), 0).x;
+}
+
+// coord runs from the lowest band to the highest; time 0 is the newest
+float sampleBandAudio(float coord, float time) {
+    return textureLod(bandAudio_buffer, vec2(coord, historyCoord(bandAudioNewestRow, bandAudio_size.y, bandAudio_invSize.y, time)), 0).x;
+}
+
+float sampleExactBandAudio(int band, int time) {
+    return texelFetch(bandAudio_buffer, ivec2(band, historyRow(bandAudioNewestRow, bandAudio_size.y, time)), 0).x;
+}
+
+float sampleAverageBandOverNFrames(float coord, int n) {
+    float sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        sum += sampleBandAudio(coord, i);
+    }
+    return sum / float(n);
+}
+
+vec2 sampleConstantQAudio(float coord, float time) {
+    return textureLod(constantQAudio_buffer, vec2(coord, historyCoord(constantQAudioNewestRow, constantQAudio_size.y, constantQAudio_invSize.y, time)), 0).xy;
+}
+
+float sampleConstantQMagnitudeAudio(float coord, float time) {
+    return length(sampleConstantQAudio(coord, time));
+}
+
+// Texture coordinate of the constant-Q bin at hz, e.g. 440.0 * pow(2.0, (midiNote - 69.0) / 12.0)
+float constantQCoord(float hz) {
+    return (constantQBinsPerOctave * log2(hz / constantQMinFrequency) + 0.5) * constantQAudio_invSize.x;
+}
+
 float log10(float x) {
     return log(x) / log(10.0);
 }
 
+// s is one of the single-row dB textures, e.g. fastEWMAfreqDb_buffer
 float sampleFrequencyDbAudio(sampler2D s, float coord) {
-    return 20.0*log10(textureLod(s, vec2(coord, 0.5), 0).x*frequencyAudio_invSize.x);
+    return textureLod(s, vec2(coord, 0.5), 0).x;
 }
 
 //https://groups.google.com/forum/#!topic/comp.dsp/cZsS1ftN5oI
 float sampleFrequencyDbAudio(float coord, float time) {
-    return 20.0*log10(sampleFrequencyMagnitudeAudio(coord, time)*frequencyAudio_invSize.x);
+    return textureLod(frequencyDbAudio_buffer, vec2(coord, historyCoord(frequencyDbAudioNewestRow, frequencyDbAudio_size.y, frequencyDbAudio_invSize.y, time)), 0).x;
 }
 
 float sampleFrequencyDbAudioOverNFrames(float coord, float scale, int n) {
@@ -48,8 +155,7 @@ float sampleFrequencyRescaledDbAudio(float coord, float scale, int time) {
 }
 
 float sampleExactFrequencyRescaledDbAudio(int coord, float scale, int time) {
-    vec2 frequency = texelFetch(frequencyAudio_buffer, ivec2(coord, frequencyAudio_size.y - time - 1), 0).xy;
-    return (20.0*log10(length(frequency)*frequencyAudio_invSize.x) + scale) / scale;
+    return (texelFetch(frequencyDbAudio_buffer, ivec2(coord, historyRow(frequencyDbAudioNewestRow, frequencyDbAudio_size.y, time)), 0).x + scale) / scale;
 }
 
 // Slow, only use for prototyping
@@ -0,0 +1,605 @@
+/**
+  \file fftbench.cpp
+
+  Standalone FFT benchmark and accuracy check for chuck_fft, built as its own project (fftbench.vcxproj) without
+  G3D. For every size, instruction set and window it times
+
+    - the original rfft()/cfft() (powers of 2 only),
+    - the planned in-place (powers of 2 only) and Stockham transforms, one frame at a time,
+    - FFTBatch (real and complex, with round trips) on one thread and on every thread,
+    - SlidingDFT tracking a few bins of a window, per hop (power-of-2 sizes from 1024 up),
+
+  compares each result against a double-precision reference DFT, and writes one record per case as JSON (the
+  default) or CSV, so runs can be diffed and regressions caught automatically. The exit code is nonzero if any
+  case is less accurate than --tolerance.
+
+  Usage: fftbench [--min N] [--max N] [--time seconds] [--threads N] [--tolerance t] [--csv] [--out file]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../source/chuck_fft.h"
+#include "../source/FFTBatch.h"
+#include "../source/SlidingDFT.h"
+#include "../source/ThreadPool.h"
+
+namespace {
+
+typedef std::complex<double> Complex;
+
+const double pi = 3.14159265358979323846;
+
+struct Options {
+    long        minSize;
+    long        maxSize;
+    /** Each timing runs for at least this long, best of three */
+    double      minTime;
+    int         threadCount;
+    double      tolerance;
+    bool        csv;
+    std::string outFilename;
+
+    Options() :
+        minSize(64),
+        maxSize(65536),
+        minTime(0.05),
+        threadCount(std::max(1, (int)std::thread::hardware_concurrency())),
+        tolerance(1e-4),
+        csv(false) {}
+};
+
+/** One line of the report */
+struct Result {
+    std::string transform;
+    std::string simd;
+    std::string window;
+    int         threadCount;
+    /** Real points for the real transforms, complex points for the complex ones */
+    long        size;
+    double      nanosecondsPerTransform;
+    /** The usual benchFFT figure: 5 N log2(N) flops for a complex transform, half that for a real one, per
+        microsecond. Only comparable between transforms of the same size */
+    double      mflops;
+    /** Largest error in any output, and the RMS error, both relative to the largest reference output */
+    double      maxError;
+    double      rmsError;
+    /** Largest error after a forward and inverse transform, relative to the largest input; negative when the
+        transform has no inverse here */
+    double      roundTripError;
+};
+
+
+/** Recursive mixed-radix DFT in double precision, with the same sign and scale as cfft(): x of length n with
+    stride \a stride becomes sum_k x[k] exp(+2 pi i jk / n), unscaled. Factors of 2, 3 and 5 split; anything else
+    is summed directly, so it's exact (to double rounding) for every size */
+void referenceDFT(const Complex* x, long n, long stride, Complex* out) {
+    long radix = 0;
+    for (long r : { 2L, 3L, 5L }) {
+        if ((n % r == 0) && (n > r)) {
+            radix = r;
+            break;
+        }
+    }
+
+    if (radix == 0) {
+        for (long j = 0; j < n; ++j) {
+            Complex sum = 0;
+            for (long k = 0; k < n; ++k) {
+                sum += x[k * stride] * std::polar(1.0, 2.0 * pi * (double)((j * k) % n) / n);
+            }
+            out[j] = sum;
+        }
+        return;
+    }
+
+    // Decimation in time: transform the radix interleaved subsequences, then combine
+    const long m = n / radix;
+    std::vector<Complex> sub(n);
+    for (long r = 0; r < radix; ++r) {
+        referenceDFT(x + r * stride, m, stride * radix, sub.data() + r * m);
+    }
+    for (long j = 0; j < n; ++j) {
+        Complex sum = 0;
+        for (long r = 0; r < radix; ++r) {
+            sum += sub[r * m + j % m] * std::polar(1.0, 2.0 * pi * (double)((r * j) % n) / n);
+        }
+        out[j] = sum;
+    }
+}
+
+
+/** Reference for cfft(): NC interleaved complex values, scaled by 1 / (2 NC) */
+std::vector<double> referenceComplex(const float* in, long NC) {
+    std::vector<Complex> x(NC);
+    std::vector<Complex> X(NC);
+    for (long i = 0; i < NC; ++i) {
+        x[i] = Complex(in[2 * i], in[2 * i + 1]);
+    }
+    referenceDFT(x.data(), NC, 1, X.data());
+
+    std::vector<double> out(2 * NC);
+    for (long k = 0; k < NC; ++k) {
+        out[2 * k] = X[k].real() / (2.0 * NC);
+        out[2 * k + 1] = X[k].imag() / (2.0 * NC);
+    }
+    return out;
+}
+
+
+/** Reference for rfft(): N real values times \a window (or not, if null), scaled by 1 / N, packed like rfft()
+    with the real DC and Nyquist values in the first two floats */
+std::vector<double> referenceReal(const float* in, const float* window, long N) {
+    std::vector<Complex> x(N);
+    std::vector<Complex> X(N);
+    for (long i = 0; i < N; ++i) {
+        x[i] = window ? (double)in[i] * (double)window[i] : (double)in[i];
+    }
+    referenceDFT(x.data(), N, 1, X.data());
+
+    std::vector<double> out(N);
+    out[0] = X[0].real() / N;
+    out[1] = X[N / 2].real() / N;
+    for (long k = 1; k < N / 2; ++k) {
+        out[2 * k] = X[k].real() / N;
+        out[2 * k + 1] = X[k].imag() / N;
+    }
+    return out;
+}
+
+
+void measureError(const float* out, const std::vector<double>& reference, Result& result) {
+    double peak = 0.0;
+    for (double v : reference) {
+        peak = std::max(peak, std::fabs(v));
+    }
+    double maxError = 0.0;
+    double sumSquare = 0.0;
+    for (size_t i = 0; i < reference.size(); ++i) {
+        const double e = std::fabs(out[i] - reference[i]);
+        maxError = std::max(maxError, e);
+        sumSquare += e * e;
+    }
+    peak = std::max(peak, 1e-300);
+    result.maxError = maxError / peak;
+    result.rmsError = std::sqrt(sumSquare / reference.size()) / peak;
+}
+
+
+double roundTripError(const float* in, const float* out, long count) {
+    double peak = 0.0;
+    double maxError = 0.0;
+    for (long i = 0; i < count; ++i) {
+        peak = std::max(peak, (double)std::fabs(in[i]));
+        maxError = std::max(maxError, (double)std::fabs(out[i] - in[i]));
+    }
+    return maxError / std::max(peak, 1e-300);
+}
+
+
+/** Seconds per call of \a f: calls it in growing batches until a batch takes at least \a minTime, best of three */
+template<class Function>
+double timePerCall(double minTime, Function f) {
+    typedef std::chrono::steady_clock Clock;
+    double best = 1e30;
+    for (int trial = 0; trial < 3; ++trial) {
+        long calls = 1;
+        while (true) {
+            const Clock::time_point start = Clock::now();
+            for (long i = 0; i < calls; ++i) {
+                f();
+            }
+            const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            if ((elapsed >= minTime) || (calls >= (1L << 30))) {
+                best = std::min(best, elapsed / calls);
+                break;
+            }
+            calls *= 2;
+        }
+    }
+    return best;
+}
+
+
+const char* windowName(int window) {
+    switch (window) {
+    case FFT_WINDOW_HANNING:    return "hann";
+    case FFT_WINDOW_HAMMING:    return "hamming";
+    case FFT_WINDOW_BLACKMAN:   return "blackman";
+    default:                    return "none";
+    }
+}
+
+
+class Benchmark {
+protected:
+    const Options&              m_options;
+    std::vector<Result>         m_results;
+    std::unique_ptr<ThreadPool> m_pool;
+    std::mt19937                m_random;
+
+    /** Random input in [-1, 1] */
+    std::vector<float> randomSignal(long count) {
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        std::vector<float> x(count);
+        for (float& v : x) {
+            v = distribution(m_random);
+        }
+        return x;
+    }
+
+    Result& addResult(const std::string& transform, const std::string& simd, const std::string& window,
+                      int threadCount, long size, double secondsPerTransform, bool real) {
+        Result r;
+        r.transform = transform;
+        r.simd = simd;
+        r.window = window;
+        r.threadCount = threadCount;
+        r.size = size;
+        r.nanosecondsPerTransform = secondsPerTransform * 1e9;
+        r.mflops = (real ? 2.5 : 5.0) * size * std::log2((double)size) / (secondsPerTransform * 1e6);
+        r.maxError = 0.0;
+        r.rmsError = 0.0;
+        r.roundTripError = -1.0;
+        m_results.push_back(r);
+        std::fprintf(stderr, "%-22s %-7s %-8s %2d threads %6ld: %10.0f ns\n", transform.c_str(), simd.c_str(),
+                     window.c_str(), threadCount, size, r.nanosecondsPerTransform);
+        return m_results.back();
+    }
+
+    /** The original transforms, which work in place, so the input is copied back before every call. The copy
+        is timed on its own and subtracted. Like the planned ones, rfft() takes the number of complex points */
+    void benchmarkLegacy(long N) {
+        const std::vector<float> x = randomSignal(N);
+        std::vector<float> y(N);
+        const double copyTime = timePerCall(m_options.minTime, [&]() { memcpy(y.data(), x.data(), sizeof(float) * N); });
+
+        double t = timePerCall(m_options.minTime, [&]() {
+            memcpy(y.data(), x.data(), sizeof(float) * N);
+            rfft(y.data(), N / 2, FFT_FORWARD);
+        }) - copyTime;
+        memcpy(y.data(), x.data(), sizeof(float) * N);
+        rfft(y.data(), N / 2, FFT_FORWARD);
+        Result& real = addResult("rfft", "legacy", "none", 1, N, t, true);
+        measureError(y.data(), referenceReal(x.data(), nullptr, N), real);
+        rfft(y.data(), N / 2, FFT_INVERSE);
+        real.roundTripError = roundTripError(x.data(), y.data(), N);
+
+        const std::vector<float> z = randomSignal(2 * N);
+        std::vector<float> w(2 * N);
+        const double complexCopyTime = timePerCall(m_options.minTime, [&]() { memcpy(w.data(), z.data(), sizeof(float) * 2 * N); });
+        t = timePerCall(m_options.minTime, [&]() {
+            memcpy(w.data(), z.data(), sizeof(float) * 2 * N);
+            cfft(w.data(), N, FFT_FORWARD);
+        }) - complexCopyTime;
+        memcpy(w.data(), z.data(), sizeof(float) * 2 * N);
+        cfft(w.data(), N, FFT_FORWARD);
+        Result& complex = addResult("cfft", "legacy", "none", 1, N, t, false);
+        measureError(w.data(), referenceComplex(z.data(), N), complex);
+        cfft(w.data(), N, FFT_INVERSE);
+        complex.roundTripError = roundTripError(z.data(), w.data(), 2 * N);
+    }
+
+    /** Planned transforms of N real points, one frame at a time */
+    void benchmarkRealPlan(const fft_plan* plan, long N) {
+        const std::string simd = fft_simd_name(fft_plan_simd(plan));
+        const std::vector<float> x = randomSignal(N);
+        std::vector<float> y(N);
+        std::vector<float> work(N);
+
+        // Mixed-radix plans have no in-place stages
+        if (fft_plan_in_place(plan)) {
+            const double copyTime = timePerCall(m_options.minTime, [&]() { memcpy(y.data(), x.data(), sizeof(float) * N); });
+            const double t = timePerCall(m_options.minTime, [&]() {
+                memcpy(y.data(), x.data(), sizeof(float) * N);
+                rfft_with_plan(plan, y.data(), FFT_FORWARD);
+            }) - copyTime;
+            memcpy(y.data(), x.data(), sizeof(float) * N);
+            rfft_with_plan(plan, y.data(), FFT_FORWARD);
+            Result& inPlace = addResult("rfft_with_plan", simd, "none", 1, N, t, true);
+            measureError(y.data(), referenceReal(x.data(), nullptr, N), inPlace);
+            rfft_with_plan(plan, y.data(), FFT_INVERSE);
+            inPlace.roundTripError = roundTripError(x.data(), y.data(), N);
+        }
+
+        for (int window = FFT_WINDOW_NONE; window < FFT_WINDOW_COUNT; ++window) {
+            const float* table = fft_plan_window(plan, window);
+            const double t = timePerCall(m_options.minTime, [&]() { rfft_stockham_windowed(plan, x.data(), table, y.data(), work.data()); });
+            rfft_stockham_windowed(plan, x.data(), table, y.data(), work.data());
+            Result& stockham = addResult("rfft_stockham", simd, windowName(window), 1, N, t, true);
+            measureError(y.data(), referenceReal(x.data(), table, N), stockham);
+            if (window == FFT_WINDOW_NONE) {
+                std::vector<float> z(N);
+                rfft_stockham(plan, y.data(), z.data(), work.data(), FFT_INVERSE);
+                stockham.roundTripError = roundTripError(x.data(), z.data(), N);
+            }
+        }
+    }
+
+    /** Planned transforms of NC complex points, one frame at a time */
+    void benchmarkComplexPlan(const fft_plan* plan, long NC) {
+        const std::string simd = fft_simd_name(fft_plan_simd(plan));
+        const std::vector<float> x = randomSignal(2 * NC);
+        const std::vector<double> reference = referenceComplex(x.data(), NC);
+        std::vector<float> y(2 * NC);
+        std::vector<float> work(2 * NC);
+
+        if (fft_plan_in_place(plan)) {
+            const double copyTime = timePerCall(m_options.minTime, [&]() { memcpy(y.data(), x.data(), sizeof(float) * 2 * NC); });
+            const double t = timePerCall(m_options.minTime, [&]() {
+                memcpy(y.data(), x.data(), sizeof(float) * 2 * NC);
+                cfft_with_plan(plan, y.data(), FFT_FORWARD);
+            }) - copyTime;
+            memcpy(y.data(), x.data(), sizeof(float) * 2 * NC);
+            cfft_with_plan(plan, y.data(), FFT_FORWARD);
+            Result& inPlace = addResult("cfft_with_plan", simd, "none", 1, NC, t, false);
+            measureError(y.data(), reference, inPlace);
+            cfft_with_plan(plan, y.data(), FFT_INVERSE);
+            inPlace.roundTripError = roundTripError(x.data(), y.data(), 2 * NC);
+        }
+
+        const double t = timePerCall(m_options.minTime, [&]() { cfft_stockham(plan, x.data(), y.data(), work.data(), FFT_FORWARD); });
+        cfft_stockham(plan, x.data(), y.data(), work.data(), FFT_FORWARD);
+        Result& stockham = addResult("cfft_stockham", simd, "none", 1, NC, t, false);
+        measureError(y.data(), reference, stockham);
+        std::vector<float> z(2 * NC);
+        cfft_stockham(plan, y.data(), z.data(), work.data(), FFT_INVERSE);
+        stockham.roundTripError = roundTripError(x.data(), z.data(), 2 * NC);
+    }
+
+    /** FFTBatch over enough frames of N real (\a realPlan) and then N complex (\a complexPlan) points to keep
+        every thread busy, on one thread and then on all of them. Accuracy and the round trip are checked on the
+        first and last frames */
+    void benchmarkBatch(const fft_plan* realPlan, const fft_plan* complexPlan, long N) {
+        const std::string simd = fft_simd_name(fft_plan_simd(realPlan));
+        const long frameCount = std::max(4L * m_options.threadCount, (1L << 20) / N);
+        const std::vector<float> x = randomSignal(2 * N * frameCount);
+        std::vector<float> y(2 * N * frameCount);
+        std::vector<float> z(2 * N * frameCount);
+
+        for (int pass = 0; pass < 2; ++pass) {
+            ThreadPool* pool = (pass == 0) ? nullptr : m_pool.get();
+            const int threadCount = pool ? pool->threadCount() : 1;
+            if ((pass == 1) && (threadCount == 1)) {
+                break;
+            }
+
+            FFTBatch realBatch(realPlan, pool);
+            for (int window = FFT_WINDOW_NONE; window < FFT_WINDOW_COUNT; ++window) {
+                const float* table = fft_plan_window(realPlan, window);
+                const double t = timePerCall(m_options.minTime, [&]() {
+                    realBatch.rfftWindowed(x.data(), N, table, y.data(), N, frameCount);
+                });
+                Result& r = addResult("rfft_batch", simd, windowName(window), threadCount, N, t / frameCount, true);
+                if (window == FFT_WINDOW_NONE) {
+                    realBatch.rfft(y.data(), N, z.data(), N, frameCount, FFT_INVERSE);
+                    r.roundTripError = 0.0;
+                }
+                for (long f : { 0L, frameCount - 1 }) {
+                    Result frame = r;
+                    measureError(y.data() + f * N, referenceReal(x.data() + f * N, table, N), frame);
+                    r.maxError = std::max(r.maxError, frame.maxError);
+                    r.rmsError = std::max(r.rmsError, frame.rmsError);
+                    if (window == FFT_WINDOW_NONE) {
+                        r.roundTripError = std::max(r.roundTripError, roundTripError(x.data() + f * N, z.data() + f * N, N));
+                    }
+                }
+            }
+
+            // Frames of N complex points, so half as many fit in the same memory
+            const long complexFrameCount = std::max(4L * m_options.threadCount, (1L << 20) / (2 * N));
+            FFTBatch complexBatch(complexPlan, pool);
+            const double t = timePerCall(m_options.minTime, [&]() {
+                complexBatch.cfft(x.data(), 2 * N, y.data(), 2 * N, complexFrameCount);
+            });
+            Result& r = addResult("cfft_batch", simd, "none", threadCount, N, t / complexFrameCount, false);
+            complexBatch.cfft(y.data(), 2 * N, z.data(), 2 * N, complexFrameCount, FFT_INVERSE);
+            r.roundTripError = 0.0;
+            for (long f : { 0L, complexFrameCount - 1 }) {
+                Result frame = r;
+                measureError(y.data() + f * 2 * N, referenceComplex(x.data() + f * 2 * N, N), frame);
+                r.maxError = std::max(r.maxError, frame.maxError);
+                r.rmsError = std::max(r.rmsError, frame.rmsError);
+                r.roundTripError = std::max(r.roundTripError, roundTripError(x.data() + f * 2 * N, z.data() + f * 2 * N, 2 * N));
+            }
+        }
+    }
+
+    /** SlidingDFT tracking 24 log-spaced bins (40 Hz to 8 kHz at 48 kHz) of an N-sample window read every N / 16
+        samples, as the app does with N = 4096. The time is per hop, update() and magnitudes() together, so it
+        compares directly with rfft_stockham of the same size and window; mflops is left at 0. Accuracy is
+        checked on the tracked bins of the last window */
+    void benchmarkSliding(long N) {
+        const long hop = N / 16;
+        const std::vector<int> bins = SlidingDFT::logSpacedBins((int)N, 48000.0, 40.0, 8000.0, 24);
+        const std::vector<float> x = randomSignal(2 * N);
+        std::vector<float> magnitudes(bins.size());
+        std::vector<float> hann(N);
+        fft_window_fill(hann.data(), N, FFT_WINDOW_HANNING);
+
+        for (bool hannWindow : { false, true }) {
+            SlidingDFT sliding;
+            sliding.init((int)N, (int)hop, bins, hannWindow);
+            long position = 0;
+            const double t = timePerCall(m_options.minTime, [&]() {
+                sliding.update(x.data() + position, (int)hop);
+                sliding.magnitudes(magnitudes.data());
+                position = (position + hop) % (2 * N);
+            });
+            Result& r = addResult("sliding_dft", "auto", hannWindow ? "hann" : "none", 1, N, t, true);
+            r.mflops = 0.0;
+
+            // Compare with the reference spectrum of the last window, relative to its largest value like the rest
+            sliding.reset();
+            for (long i = 0; i < 2 * N; i += hop) {
+                sliding.update(x.data() + i, (int)hop);
+            }
+            const std::vector<double> reference = referenceReal(x.data() + N, hannWindow ? hann.data() : nullptr, N);
+            double peak = 1e-300;
+            for (double v : reference) {
+                peak = std::max(peak, std::fabs(v));
+            }
+            double sumSquare = 0.0;
+            for (int i = 0; i < sliding.binCount(); ++i) {
+                const std::complex<double> error = sliding.value(i) - Complex(reference[2 * sliding.bin(i)], reference[2 * sliding.bin(i) + 1]);
+                r.maxError = std::max(r.maxError, std::abs(error) / peak);
+                sumSquare += std::norm(error);
+            }
+            r.rmsError = std::sqrt(sumSquare / sliding.binCount()) / peak;
+        }
+    }
+
+public:
+
+    explicit Benchmark(const Options& options) :
+        m_options(options),
+        m_random(476) {
+        if (options.threadCount > 1) {
+            m_pool.reset(new ThreadPool(options.threadCount - 1));
+        }
+    }
+
+    void run() {
+        // Powers of 2, and 15 * 2^k, the mixed-radix sizes blocks of 480 and 960 frames need
+        std::vector<long> sizes;
+        for (long N = 16; N <= m_options.maxSize; N *= 2) {
+            sizes.push_back(N);
+            sizes.push_back(15 * N);
+        }
+        std::sort(sizes.begin(), sizes.end());
+
+        for (long N : sizes) {
+            if ((N < m_options.minSize) || (N > m_options.maxSize)) {
+                continue;
+            }
+            const bool powerOf2 = (N & (N - 1)) == 0;
+            if (powerOf2) {
+                benchmarkLegacy(N);
+            }
+            for (int simd : { FFT_SIMD_NONE, FFT_SIMD_SSE2, FFT_SIMD_AVX2, FFT_SIMD_NEON }) {
+                if (!fft_simd_available(simd)) {
+                    continue;
+                }
+                fft_plan* realPlan = fft_plan_create_simd(N / 2, simd);
+                fft_plan* complexPlan = fft_plan_create_simd(N, simd);
+                if (realPlan && complexPlan) {
+                    benchmarkRealPlan(realPlan, N);
+                    benchmarkComplexPlan(complexPlan, N);
+                    benchmarkBatch(realPlan, complexPlan, N);
+                }
+                fft_plan_destroy(realPlan);
+                fft_plan_destroy(complexPlan);
+            }
+            if (powerOf2 && (N >= 1024)) {
+                benchmarkSliding(N);
+            }
+        }
+    }
+
+    /** Number of cases less accurate than the tolerance, each reported on stderr */
+    int failureCount() const {
+        int count = 0;
+        for (const Result& r : m_results) {
+            if ((r.maxError > m_options.tolerance) || (r.roundTripError > m_options.tolerance)) {
+                std::fprintf(stderr, "FAIL %s %s %s %d threads %ld: error %g, round trip %g\n", r.transform.c_str(),
+                             r.simd.c_str(), r.window.c_str(), r.threadCount, r.size, r.maxError, r.roundTripError);
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    void writeCSV(FILE* file) const {
+        std::fprintf(file, "transform,simd,window,threads,size,ns_per_transform,mflops,max_error,rms_error,round_trip_error\n");
+        for (const Result& r : m_results) {
+            std::fprintf(file, "%s,%s,%s,%d,%ld,%.1f,%.1f,%.3g,%.3g,", r.transform.c_str(), r.simd.c_str(), r.window.c_str(),
+                         r.threadCount, r.size, r.nanosecondsPerTransform, r.mflops, r.maxError, r.rmsError);
+            if (r.roundTripError >= 0.0) {
+                std::fprintf(file, "%.3g", r.roundTripError);
+            }
+            std::fprintf(file, "\n");
+        }
+    }
+
+    void writeJSON(FILE* file) const {
+        std::fprintf(file, "{\n  \"threads\": %d,\n  \"tolerance\": %g,\n  \"results\": [\n", m_options.threadCount, m_options.tolerance);
+        for (size_t i = 0; i < m_results.size(); ++i) {
+            const Result& r = m_results[i];
+            std::fprintf(file, "    { \"transform\": \"%s\", \"simd\": \"%s\", \"window\": \"%s\", \"threads\": %d, \"size\": %ld, "
+                         "\"ns_per_transform\": %.1f, \"mflops\": %.1f, \"max_error\": %.3g, \"rms_error\": %.3g, \"round_trip_error\": ",
+                         r.transform.c_str(), r.simd.c_str(), r.window.c_str(), r.threadCount, r.size,
+                         r.nanosecondsPerTransform, r.mflops, r.maxError, r.rmsError);
+            if (r.roundTripError >= 0.0) {
+                std::fprintf(file, "%.3g }", r.roundTripError);
+            } else {
+                std::fprintf(file, "null }");
+            }
+            std::fprintf(file, (i + 1 < m_results.size()) ? ",\n" : "\n");
+        }
+        std::fprintf(file, "  ]\n}\n");
+    }
+};
+
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+        if ((arg == "--min") && hasValue) {
+            options.minSize = atol(argv[++i]);
+        } else if ((arg == "--max") && hasValue) {
+            options.maxSize = atol(argv[++i]);
+        } else if ((arg == "--time") && hasValue) {
+            options.minTime = atof(argv[++i]);
+        } else if ((arg == "--threads") && hasValue) {
+            options.threadCount = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--tolerance") && hasValue) {
+            options.tolerance = atof(argv[++i]);
+        } else if (arg == "--csv") {
+            options.csv = true;
+        } else if ((arg == "--out") && hasValue) {
+            options.outFilename = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--min N] [--max N] [--time seconds] [--threads N] [--tolerance t] [--csv] [--out file]\n", argv[0]);
+        return 2;
+    }
+
+    Benchmark benchmark(options);
+    benchmark.run();
+
+    FILE* file = options.outFilename.empty() ? stdout : std::fopen(options.outFilename.c_str(), "w");
+    if (!file) {
+        std::fprintf(stderr, "Could not open %s\n", options.outFilename.c_str());
+        return 2;
+    }
+    if (options.csv) {
+        benchmark.writeCSV(file);
+    } else {
+        benchmark.writeJSON(file);
+    }
+    if (file != stdout) {
+        std::fclose(file);
+    }
+
+    return (benchmark.failureCount() > 0) ? 1 : 0;
+}
@@ -5,7 +5,6 @@
 G3D_START_AT_MAIN();
 
 int main(int argc, const char* argv[]) {
-    (void)argc; (void)argv;
     GApp::Settings settings(argc, argv);
     
     // Change the window and other startup parameters by modifying the
@@ -22,28 +21,63 @@ int main(int argc, const char* argv[]) {
     settings.renderer.orderIndependentTransparency = true;
 
 
-    return App(settings).run();
+    // Optionally play back a recording instead of the live input: HearEyeAm file.wav
+    // or generate test signals, e.g. for benchmarking on a headless machine: HearEyeAm --synthetic
+    String audioFilename = (argc > 1) ? String(argv[1]) : String();
+
+    return App(settings, audioFilename).run();
 }
 
 
-App::App(const GApp::Settings& settings) : GApp(settings) {
+App::App(const GApp::Settings& settings, const String& audioFilename) : GApp(settings) {
     renderDevice->setColorClearValue(Color3::white());
+    m_audioCallbackData.queue = &m_audioBlockQueue;
+    m_audioCallbackData.stats = &m_audioCallbackStats;
+    m_audioStatsFile = nullptr;
+    if (audioFilename == "--synthetic") {
+        m_audioSettings.inputSource = InputSource::SYNTHETIC;
+    } else if (!audioFilename.empty()) {
+        m_audioFilenameField = audioFilename;
+        m_audioSettings.inputSource = InputSource::FILE;
+        m_audioSettings.filename = audioFilename;
+    }
 }
 
 void App::onCleanup() {
-  m_rtAudio.stopStream();
-  if( m_rtAudio.isStreamOpen() )
-    m_rtAudio.closeStream();
+  closeAudioStream();
+  if( notNull(m_audioStatsFile) ) {
+    fclose( m_audioStatsFile );
+    m_audioStatsFile = nullptr;
+  }
+}
+
+/** Shared by both callbacks: hand the (interleaved) block to the analysis thread, stamped with where it sits on the
+    audio clock and when it arrived, and record how the callback that started at \a startTime went.
+    Never blocks or allocates; if the queue is full the block is dropped. */
+static void pushCapturedBlock( AudioCallbackData * callbackData, const float * input, unsigned int numFrames,
+            double streamTime, RtAudioStreamStatus status, double startTime ) {
+  AudioBlockQueue * queue = callbackData->queue;
+  queue->push(input, numFrames * queue->channelCount(), streamTime, startTime, status);
+  callbackData->stats->recordCallback(startTime, audioCaptureClock(),
+      (status & RTAUDIO_INPUT_OVERFLOW) != 0, (status & RTAUDIO_OUTPUT_UNDERFLOW) != 0);
+}
+
+int captureCallback( void * outputBuffer, void * inputBuffer, unsigned int numFrames,
+            double streamTime, RtAudioStreamStatus status, void * data ) {
+  const double startTime = audioCaptureClock();
+  pushCapturedBlock( (AudioCallbackData *)data, (const float *)inputBuffer, numFrames, streamTime, status, startTime );
+  return 0;
 }
 
 int audioCallback( void * outputBuffer, void * inputBuffer, unsigned int numFrames,
             double streamTime, RtAudioStreamStatus status, void * data ) {
+  const double startTime = audioCaptureClock();
+  AudioCallbackData * callbackData = (AudioCallbackData *)data;
   float * output = (float *)outputBuffer;
-  float * input  = (float *)inputBuffer;
-  size_t numBytes = numFrames * sizeof(float);
+  // The output stream has as many channels as the input
+  size_t numBytes = numFrames * callbackData->queue->channelCount() * sizeof(float);
   memset(output, 0, numBytes);
-  // Copy input buffer, handle race condition by not caring about it.
-  memcpy(g_currentAudioBuffer.getCArray(), input, numBytes);
+  pushCapturedBlock( callbackData, (const float *)inputBuffer, numFrames, streamTime, status, startTime );
   return 0;
 }
 
@@ -51,22 +85,45 @@ int audioCallback( void * outputBuffer, void * inputBuffer, unsigned int numFram
 
 void App::initializeAudio() {
 
-  unsigned int bufferByteCount = 0;
-  unsigned int bufferFrameCount = 512;
-    
   // Check for audio devices
-  if( m_rtAudio.getDeviceCount() < 1 ) {
-    // None :(
-    debugPrintf("No audio devices found!\n");
+  if( (m_audioSettings.inputSource == InputSource::DEVICE) && (m_rtAudio.getDeviceCount() < 1) ) {
+    // None :( Keep the whole pipeline running on generated audio instead
+    debugPrintf("No audio devices found! Using the synthetic signal generator.\n");
+    m_audioSettings.inputSource = InputSource::SYNTHETIC;
+  }
+
+  // Let RtAudio print messages to stderr.
+  m_rtAudio.showWarnings( true );
+
+  if( !openAudioStream() ) {
     exit( 1 );
   }
-  RtAudio::DeviceInfo info;
+}
 
-  unsigned int devices = m_rtAudio.getDeviceCount();
+bool App::openAudioStream() {
 
+  if( (m_audioSettings.inputSource != InputSource::DEVICE) && !AudioAnalyzer::supportsSTFT(m_audioSettings.bufferFrameCount, stftSettings()) ) {
+    debugPrintf("Can't analyze %d-frame blocks with a %d-sample window\n", m_audioSettings.bufferFrameCount, m_audioSettings.stftWindowLength);
+    return false;
+  }
 
-  // Let RtAudio print messages to stderr.
-  m_rtAudio.showWarnings( true );
+  if( m_audioSettings.inputSource == InputSource::FILE ) {
+    shared_ptr<WavFileAudioSource> file = WavFileAudioSource::create( m_audioSettings.filename, m_audioSettings.loopFile, m_audioSettings.sampleRate );
+    if( isNull(file) ) {
+      return false;
+    }
+    startAudioSource( file );
+    return true;
+  }
+
+  if( m_audioSettings.inputSource == InputSource::SYNTHETIC ) {
+    SyntheticAudioSource::Settings synthetic = m_audioSettings.synthetic;
+    synthetic.sampleRate = m_audioSettings.sampleRate;
+    startAudioSource( SyntheticAudioSource::create( synthetic ) );
+    return true;
+  }
+
+  unsigned int bufferFrameCount = m_audioSettings.bufferFrameCount;
 
   // Set input and output parameters
   RtAudio::StreamParameters iParams, oParams;
@@ -80,18 +137,201 @@ void App::initializeAudio() {
   // Create stream options
   RtAudio::StreamOptions options;
 
-  g_currentAudioBuffer.resize(bufferFrameCount);
+  // In input-only mode, pass no output parameters so RtAudio only opens the capture device
+  bool duplex = (m_audioSettings.streamMode == StreamMode::DUPLEX);
   try {
     // Open a stream
-    m_rtAudio.openStream( &oParams, &iParams, m_audioSettings.rtAudioFormat, m_audioSettings.sampleRate, &bufferFrameCount, &audioCallback, (void *)&bufferByteCount, &options );
+    m_rtAudio.openStream( duplex ? &oParams : nullptr, &iParams, m_audioSettings.rtAudioFormat, m_audioSettings.sampleRate, &bufferFrameCount, duplex ? &audioCallback : &captureCallback, (void *)&m_audioCallbackData, &options );
   } catch( RtAudioError& e ) {
     // Failed to open stream
     std::cout << e.getMessage() << std::endl;
-    exit( 1 );
+    return false;
   }
-  g_currentAudioBuffer.resize(bufferFrameCount);
+  // RtAudio may have changed bufferFrameCount, so only check and size everything once the stream is open
+  if( !AudioAnalyzer::supportsSTFT(bufferFrameCount, stftSettings()) ) {
+    debugPrintf("The device picked %u-frame blocks, which can't be analyzed\n", bufferFrameCount);
+    m_rtAudio.closeStream();
+    return false;
+  }
+  m_audioBlockQueue.init(bufferFrameCount, m_audioSettings.numChannels, m_audioQueueBlockCapacity);
+  m_audioAnalyzer.start(&m_audioBlockQueue, m_maxSavedTimeSlices, bufferFrameCount / (RealTime)m_audioSettings.sampleRate, stftSettings(),
+    slidingSpectrumSettings(m_audioSettings.sampleRate), filterbankSettings(m_audioSettings.sampleRate), constantQSettings(m_audioSettings.sampleRate, bufferFrameCount),
+    m_onsetSettings);
+  m_audioCallbackStats.reset(bufferFrameCount / (double)m_audioSettings.sampleRate);
   m_rtAudio.startStream();
+  return true;
+}
+
+STFTSettings App::stftSettings() const {
+  return STFTSettings(m_audioSettings.stftWindowLength, m_audioSettings.stftHopLength);
+}
+
+SlidingSpectrumSettings App::slidingSpectrumSettings(int sampleRate) const {
+  SlidingSpectrumSettings settings;
+  settings.windowLength = m_slidingSpectrumWindowLength;
+  settings.hopLength = m_slidingSpectrumHopLength;
+  settings.bins = SlidingDFT::logSpacedBins(m_slidingSpectrumWindowLength, sampleRate, m_slidingSpectrumMinFrequency, m_slidingSpectrumMaxFrequency, m_slidingSpectrumBinCount);
+  return settings;
+}
+
+FilterbankSettings App::filterbankSettings(int sampleRate) const {
+  FilterbankSettings settings;
+  settings.bandCount = m_bandCount;
+  settings.sampleRate = sampleRate;
+  settings.minFrequency = m_bandMinFrequency;
+  settings.maxFrequency = m_bandMaxFrequency;
+  settings.scale = m_bandScale;
+  return settings;
+}
+
+ConstantQSettings App::constantQSettings(int sampleRate, int framesPerBlock) const {
+  ConstantQSettings settings;
+  settings.binsPerOctave = m_constantQBinsPerOctave;
+  settings.sampleRate = sampleRate;
+  settings.minFrequency = m_constantQMinFrequency;
+  settings.maxFrequency = m_constantQMaxFrequency;
+  // The analyzer reads each window straight out of the raw history
+  const int historyLength = (m_maxSavedTimeSlices - 1) * framesPerBlock;
+  while( (settings.binsPerOctave > 0) && (ConstantQ::fftLengthFor(sampleRate, settings.minFrequency, settings.binsPerOctave) > historyLength) ) {
+    settings.minFrequency *= 2.0;
+  }
+  if( settings.minFrequency != m_constantQMinFrequency ) {
+    debugPrintf("Constant-Q transform starts at %g Hz instead of %g Hz to fit in the history\n", settings.minFrequency, m_constantQMinFrequency);
+  }
+  return settings;
+}
+
+void App::startAudioSource(const shared_ptr<AudioSource>& source) {
+  unsigned int bufferFrameCount = m_audioSettings.bufferFrameCount;
+  m_audioBlockQueue.init(bufferFrameCount, m_audioSettings.numChannels, m_audioQueueBlockCapacity);
+  m_audioAnalyzer.start(&m_audioBlockQueue, m_maxSavedTimeSlices, bufferFrameCount / (RealTime)source->sampleRate(), stftSettings(),
+    slidingSpectrumSettings(source->sampleRate()), filterbankSettings(source->sampleRate()), constantQSettings(source->sampleRate(), bufferFrameCount),
+    m_onsetSettings);
+  // No callback to keep statistics on
+  m_audioCallbackStats.reset(0.0);
+  source->start(&m_audioBlockQueue, m_audioSettings.sourcePacing);
+  m_audioSource = source;
+}
+
+void App::closeAudioStream() {
+  if( m_rtAudio.isStreamOpen() ) {
+    if( m_rtAudio.isStreamRunning() )
+      m_rtAudio.stopStream();
+    m_rtAudio.closeStream();
+  }
+  if( notNull(m_audioSource) ) {
+    m_audioSource->stop();
+    m_audioSource.reset();
+  }
+  // The producer has stopped, so nothing else touches the queue once the analyzer is stopped
+  m_audioAnalyzer.stop();
+}
+
+bool App::restartAudio(const AudioSettings& settings) {
+    const AudioSettings previous = m_audioSettings;
+    closeAudioStream();
+
+    m_audioSettings = settings;
+    bool success = openAudioStream();
+    if (!success) {
+        debugPrintf("Could not open the audio stream at %d frames, %d Hz, %d channels; reverting\n", settings.bufferFrameCount, settings.sampleRate, settings.numChannels);
+        m_audioSettings = previous;
+        if (!openAudioStream()) {
+            debugPrintf("Could not reopen the audio stream with the previous settings either\n");
+        }
+    }
+    // The analyzer handed the renderer an empty snapshot of the new size, so at most one frame
+    // is skipped before the new textures fill in
+    createAudioTextures();
+    return success;
+}
+
+void App::applyAudioSettingsFromGUI() {
+    AudioSettings settings = m_audioSettings;
+    settings.bufferFrameCount = atoi(m_bufferFrameCountOptions[m_bufferFrameCountIndex].c_str());
+    settings.sampleRate = atoi(m_sampleRateOptions[m_sampleRateIndex].c_str());
+    settings.numChannels = m_numChannelsField;
+    // "Block" reads as 0, which is one FFT per block; each step of overlap halves the hop
+    settings.stftWindowLength = atoi(m_stftWindowLengthOptions[m_stftWindowLengthIndex].c_str());
+    settings.stftHopLength = settings.stftWindowLength >> m_stftOverlapIndex;
+    restartAudio(settings);
+}
+
+void App::playAudioFileFromGUI() {
+    AudioSettings settings = m_audioSettings;
+    settings.inputSource = InputSource::FILE;
+    settings.filename = m_audioFilenameField;
+    restartAudio(settings);
+}
+
+void App::useLiveInputFromGUI() {
+    AudioSettings settings = m_audioSettings;
+    settings.inputSource = InputSource::DEVICE;
+    restartAudio(settings);
+}
+
+void App::useSyntheticInputFromGUI() {
+    AudioSettings settings = m_audioSettings;
+    settings.inputSource = InputSource::SYNTHETIC;
+    restartAudio(settings);
+}
+
+/** An empty ring texture for the last \a rowCapacity rows of an AudioHistory<T>. It has one row more than that,
+    for the copy of row 0 that lets shaders filter across the seam (see uploadNewRows()), and starts zeroed
+    because only rows the history appends are ever uploaded */
+template<class T>
+static shared_ptr<Texture> createHistoryTexture(const String& name, int width, int rowCapacity, const ImageFormat* format, Texture::Dimension dimension = Texture::DIM_2D, int layerCount = 1) {
+    const int height = rowCapacity + 1;
+    shared_ptr<Texture> texture = Texture::createEmpty(name, width, height, format, dimension, false, layerCount);
+    const std::vector<T> zeros((size_t)width * height * layerCount);
+    texture->update(CPUPixelTransferBuffer::fromData(width, height, format, zeros.data(), layerCount));
+    return texture;
+}
+
+/** Texture row of the newest of \a rowCount history rows in a texture made by createHistoryTexture() */
+static int newestTextureRow(const shared_ptr<Texture>& texture, uint64_t rowCount) {
+    const uint64_t rowCapacity = texture->height() - 1;
+    return (int)((rowCount + rowCapacity - 1) % rowCapacity);
+}
 
+void App::createAudioTextures() {
+    // The analyzer has already reset its snapshot to the new settings
+    const AudioAnalysisSnapshot& snapshot = m_audioAnalyzer.snapshot();
+    int sampleCount = m_audioBlockQueue.framesPerBlock();
+    int freqCount = snapshot.frequencyCount();
+    int channelCount = m_audioBlockQueue.channelCount();
+    // The snapshots only carry the newest rows, so these textures are the only full histories
+    int historyRows = m_audioAnalyzer.historyRows();
+    m_rawAudioTexture = createHistoryTexture<float>("Raw Audio Texture", sampleCount, historyRows, ImageFormat::R32F());
+
+    m_frequencyAudioTexture = createHistoryTexture<complex>("Frequency Audio Texture", freqCount, historyRows, ImageFormat::RG32F());
+    m_frequencyDbAudioTexture = createHistoryTexture<float>("Frequency dB Audio Texture", freqCount, historyRows, ImageFormat::R32F());
+
+    m_rawAudioChannelsTexture = createHistoryTexture<float>("Raw Audio Channels Texture", sampleCount, historyRows, ImageFormat::R32F(), Texture::DIM_2D_ARRAY, channelCount);
+    m_frequencyAudioChannelsTexture = createHistoryTexture<complex>("Frequency Audio Channels Texture", freqCount, historyRows, ImageFormat::RG32F(), Texture::DIM_2D_ARRAY, channelCount);
+
+    m_fastMovingAverageTexture = Texture::createEmpty("Fast Freq EWMA", freqCount, 1, ImageFormat::R32F());
+    m_slowMovingAverageTexture = Texture::createEmpty("Slow Freq EWMA", freqCount, 1, ImageFormat::R32F());
+    m_glacialMovingAverageTexture = Texture::createEmpty("Glacial Freq EWMA", freqCount, 1, ImageFormat::R32F());
+    m_fastMovingAverageDbTexture = Texture::createEmpty("Fast Freq EWMA dB", freqCount, 1, ImageFormat::R32F());
+    m_slowMovingAverageDbTexture = Texture::createEmpty("Slow Freq EWMA dB", freqCount, 1, ImageFormat::R32F());
+    m_glacialMovingAverageDbTexture = Texture::createEmpty("Glacial Freq EWMA dB", freqCount, 1, ImageFormat::R32F());
+
+    const AudioHistory<float>& slidingHistory = snapshot.slidingSpectrumHistory;
+    m_slidingSpectrumTexture = createHistoryTexture<float>("Sliding Spectrum", max(1, slidingHistory.rowSize()), historyRows, ImageFormat::R32F());
+
+    const AudioHistory<float>& bandHistory = snapshot.bandHistory;
+    m_bandTexture = createHistoryTexture<float>("Band Audio Texture", max(1, bandHistory.rowSize()), historyRows, ImageFormat::R32F());
+
+    const AudioHistory<complex>& constantQHistory = snapshot.constantQHistory;
+    m_constantQTexture = createHistoryTexture<complex>("Constant Q Audio Texture", max(1, constantQHistory.rowSize()), historyRows, ImageFormat::RG32F());
+
+    m_rawAudioRowCount = 0;
+    m_frequencyAudioRowCount = 0;
+    m_frequencyDbAudioRowCount = 0;
+    m_slidingSpectrumRowCount = 0;
+    m_bandRowCount = 0;
+    m_constantQRowCount = 0;
 }
 
 void App::onInit() {
@@ -103,11 +343,53 @@ void App::onInit() {
     m_shadertoyShaders.append("sunShader.pix", "cubescape.pix", "fractalLand.pix", "hex.pix", "playground.pix");
 
     m_maxSavedTimeSlices = 512;
+    // ~85ms window every ~5ms at 48kHz. With their Hann neighbours the 24 bins track about 65, which fftbench's
+    // sliding_dft case puts at about 40% of a windowed 4096-point AVX2 rfft_stockham per hop (5.5 against 14 us).
+    // The cost grows with m_slidingSpectrumBinCount, and much past 60 bins the FFT is cheaper (see SlidingDFT.h)
+    m_slidingSpectrumWindowLength = 4096;
+    m_slidingSpectrumHopLength = 256;
+    m_slidingSpectrumBinCount = 24;
+    m_slidingSpectrumMinFrequency = 40.0f;
+    m_slidingSpectrumMaxFrequency = 8000.0f;
+    m_bandCount = 64;
+    m_bandMinFrequency = 30.0f;
+    m_bandMaxFrequency = 16000.0f;
+    m_bandScale = Filterbank::MEL;
+    // Quarter tones from A1 to A8; the A1 window is ~0.6s, about a 32768-sample FFT at 48kHz
+    m_constantQBinsPerOctave = 24;
+    m_constantQMinFrequency = 55.0f;
+    m_constantQMaxFrequency = 7040.0f;
+    // Everything, then kick drums, the body of most instruments and voices, and cymbals
+    m_onsetSettings.bands.push_back(OnsetDetector::Band(30.0, 16000.0));
+    m_onsetSettings.bands.push_back(OnsetDetector::Band(30.0, 150.0));
+    m_onsetSettings.bands.push_back(OnsetDetector::Band(150.0, 2500.0));
+    m_onsetSettings.bands.push_back(OnsetDetector::Band(5000.0, 16000.0));
+    m_onsetDecayTime = 0.15f;
+    m_onsetCounts.resize((int)m_onsetSettings.bands.size());
+    m_onsetCounts.setAll(0);
+    m_audioQueueBlockCapacity = 64;
     m_waveformWidth = 7.9f;
-    initializeAudio();
-    m_rawAudioTexture = Texture::createEmpty("Raw Audio Texture", g_currentAudioBuffer.size(), 1, ImageFormat::R32F());
+    // 480 and 960 match the periods of devices that run at multiples of 10ms
+    m_bufferFrameCountOptions.append("128", "256", "480", "512", "960", "1024");
+    m_bufferFrameCountOptions.append("2048", "4096");
+    m_bufferFrameCountIndex = 3;
+    m_sampleRateOptions.append("22050", "44100", "48000", "96000");
+    m_sampleRateIndex = 2;
+    m_numChannelsField = m_audioSettings.numChannels;
+    m_stftWindowLengthOptions.append("Block", "1024", "2048", "4096", "8192");
+    m_stftWindowLengthIndex = 3;
+    m_stftOverlapOptions.append("0%", "50%", "75%", "87.5%");
+    m_stftOverlapIndex = 2;
+    m_fftWindowOptions.append("None", "Hann", "Hamming", "Blackman");
+    m_fftWindowIndex = FFT_WINDOW_HANNING;
+    m_animateFromAudioClock = false;
+    m_logAudioStats = false;
+    m_audioStatsFilename = "audioStats.csv";
+    m_audioStatsPeriod = 1.0;
+    m_audioStatsWindowStart = audioCaptureClock();
 
-    m_frequencyAudioTexture = Texture::createEmpty("Frequency Audio Texture", g_currentAudioBuffer.size()/2, 1, ImageFormat::RG32F());
+    initializeAudio();
+    createAudioTextures();
 
     m_visualizationMode = VisualizationMode::EYE;
 
@@ -115,8 +397,6 @@ void App::onInit() {
     
     m_secondaryEyeSettings.randomize();
 
-    m_smoothedRootMeanSquare = 0.0f;
-
     makeGUI();
     loadScene("Visualizer");
 }
@@ -136,9 +416,37 @@ void App::makeGUI() {
         debugPane->addCheckBox("Use RMS", &m_eyeSettings.useRootMeanSquarePupil);
         debugPane->addNumberBox("Pupil Size", &m_eyeSettings.pupilWidth, "", GuiTheme::LINEAR_SLIDER, 0.0f, 0.4f);
         debugPane->addNumberBox("Time Mult.", &m_eyeSettings.angleOffsetTimeMultiplier, "", GuiTheme::LINEAR_SLIDER, 0.0f, 4.0f);
+        debugPane->addCheckBox("Animate on Audio Clock", &m_animateFromAudioClock);
     } debugPane->endRow();
     GuiDropDownList* list = debugPane->addDropDownList("Shadertoy Shader", m_shadertoyShaders, &m_shadertoyShaderIndex);
     list->setCaptionWidth(100);
+    debugPane->beginRow(); {
+        debugPane->addDropDownList("Block Size", m_bufferFrameCountOptions, &m_bufferFrameCountIndex)->setCaptionWidth(100);
+        debugPane->addDropDownList("Sample Rate", m_sampleRateOptions, &m_sampleRateIndex)->setCaptionWidth(100);
+        debugPane->addNumberBox("Channels", &m_numChannelsField, "", GuiTheme::LINEAR_SLIDER, 1, 16);
+        debugPane->addButton("Reopen Audio", this, &App::applyAudioSettingsFromGUI);
+    } debugPane->endRow();
+    debugPane->beginRow(); {
+        debugPane->addDropDownList("FFT Size", m_stftWindowLengthOptions, &m_stftWindowLengthIndex)->setCaptionWidth(100);
+        debugPane->addDropDownList("Overlap", m_stftOverlapOptions, &m_stftOverlapIndex)->setCaptionWidth(100);
+        debugPane->addDropDownList("FFT Window", m_fftWindowOptions, &m_fftWindowIndex)->setCaptionWidth(100);
+    } debugPane->endRow();
+    debugPane->beginRow(); {
+        debugPane->addTextBox("Audio File", &m_audioFilenameField)->setWidth(300);
+        debugPane->addCheckBox("Loop", &m_audioSettings.loopFile);
+        debugPane->addEnumClassRadioButtons<AudioSource::Pacing>("Pacing", &m_audioSettings.sourcePacing);
+        debugPane->addButton("Play File", this, &App::playAudioFileFromGUI);
+        debugPane->addButton("Live Input", this, &App::useLiveInputFromGUI);
+    } debugPane->endRow();
+    debugPane->beginRow(); {
+        debugPane->addEnumClassRadioButtons<SyntheticAudioSource::Signal>("Signal", &m_audioSettings.synthetic.signal);
+        debugPane->addButton("Synthetic", this, &App::useSyntheticInputFromGUI);
+    } debugPane->endRow();
+    for (int i = 0; i < 3; ++i) {
+        m_audioStatsLabel[i] = debugPane->addLabel("");
+        m_audioStatsLabel[i]->setWidth(900);
+    }
+    debugPane->addCheckBox("Log Audio Stats to " + m_audioStatsFilename, &m_logAudioStats);
     debugPane->pack();
 
 
@@ -169,12 +477,64 @@ bool App::onEvent(const GEvent& e) {
     return false;
 }
 
+double App::audioTime() const {
+    const AudioAnalysisSnapshot& snapshot = m_audioAnalyzer.snapshot();
+    // The stream clock only advances a block at a time; fill in the time since the newest block arrived
+    return snapshot.streamTime + (audioCaptureClock() - snapshot.captureTime);
+}
+
+SimTime App::animationTime() {
+    return m_animateFromAudioClock ? (SimTime)audioTime() : scene()->time();
+}
+
 void App::setAudioShaderArgs(Args& args) {
+    const AudioAnalysisSnapshot& snapshot = m_audioAnalyzer.snapshot();
+    args.setUniform("audioStreamTime", (float)snapshot.streamTime);
+    args.setUniform("audioTime", (float)audioTime());
+    // How old the newest audio we're about to draw is
+    args.setUniform("audioLatency", (float)(audioCaptureClock() - snapshot.captureTime));
+
     m_rawAudioTexture->setShaderArgs(args, "rawAudio_", Sampler::video());
     m_frequencyAudioTexture->setShaderArgs(args, "frequencyAudio_", Sampler::video());
-    m_fastMovingAverage.gpuData->setShaderArgs(args, "fastEWMAfreq_", Sampler::video());
-    m_slowMovingAverage.gpuData->setShaderArgs(args, "slowEWMAfreq_", Sampler::video());
-    m_glacialMovingAverage.gpuData->setShaderArgs(args, "glacialEWMAfreq_", Sampler::video());
+    m_frequencyDbAudioTexture->setShaderArgs(args, "frequencyDbAudio_", Sampler::video());
+    m_fastMovingAverageTexture->setShaderArgs(args, "fastEWMAfreq_", Sampler::video());
+    m_slowMovingAverageTexture->setShaderArgs(args, "slowEWMAfreq_", Sampler::video());
+    m_glacialMovingAverageTexture->setShaderArgs(args, "glacialEWMAfreq_", Sampler::video());
+    m_fastMovingAverageDbTexture->setShaderArgs(args, "fastEWMAfreqDb_", Sampler::video());
+    m_slowMovingAverageDbTexture->setShaderArgs(args, "slowEWMAfreqDb_", Sampler::video());
+    m_glacialMovingAverageDbTexture->setShaderArgs(args, "glacialEWMAfreqDb_", Sampler::video());
+    m_slidingSpectrumTexture->setShaderArgs(args, "slidingSpectrum_", Sampler::video());
+    m_bandTexture->setShaderArgs(args, "bandAudio_", Sampler::video());
+    m_constantQTexture->setShaderArgs(args, "constantQAudio_", Sampler::video());
+    // The history textures are rings; shaders find each one's newest row through these
+    args.setUniform("rawAudioNewestRow", newestTextureRow(m_rawAudioTexture, m_rawAudioRowCount));
+    args.setUniform("frequencyAudioNewestRow", newestTextureRow(m_frequencyAudioTexture, m_frequencyAudioRowCount));
+    args.setUniform("frequencyDbAudioNewestRow", newestTextureRow(m_frequencyDbAudioTexture, m_frequencyDbAudioRowCount));
+    args.setUniform("slidingSpectrumNewestRow", newestTextureRow(m_slidingSpectrumTexture, m_slidingSpectrumRowCount));
+    args.setUniform("bandAudioNewestRow", newestTextureRow(m_bandTexture, m_bandRowCount));
+    args.setUniform("constantQAudioNewestRow", newestTextureRow(m_constantQTexture, m_constantQRowCount));
+    args.setUniform("constantQBinsPerOctave", (float)m_audioAnalyzer.constantQ().binsPerOctave());
+    args.setUniform("constantQMinFrequency", (float)m_audioAnalyzer.constantQ().minFrequency());
+
+    // Onset envelopes decay on the extrapolated audio clock, so they're smooth between hops
+    const double now = audioTime();
+    Vector4 onsetEnvelope = Vector4::zero();
+    Vector4 onsetStrength = Vector4::zero();
+    Vector4 onsetFlux = Vector4::zero();
+    const int onsetBandCount = min(4, snapshot.onsetBands.size());
+    for (int b = 0; b < onsetBandCount; ++b) {
+        const OnsetDetector::BandState& band = snapshot.onsetBands[b];
+        onsetEnvelope[b] = (float)exp(-max(0.0, now - band.lastOnsetTime) / m_onsetDecayTime);
+        onsetStrength[b] = band.lastOnsetStrength;
+        onsetFlux[b] = (band.threshold > 0.0f) ? band.flux / band.threshold : 0.0f;
+    }
+    args.setUniform("onsetBandCount", onsetBandCount);
+    args.setUniform("onsetEnvelope", onsetEnvelope);
+    args.setUniform("onsetStrength", onsetStrength);
+    args.setUniform("onsetFlux", onsetFlux);
+    m_rawAudioChannelsTexture->setShaderArgs(args, "rawAudioChannels_", Sampler::video());
+    m_frequencyAudioChannelsTexture->setShaderArgs(args, "frequencyAudioChannels_", Sampler::video());
+    args.setUniform("audioChannelCount", m_rawAudioChannelsTexture->depth());
 }
 
 void App::drawLineGraphFromRawSamples(RenderDevice* rd) {
@@ -207,69 +567,162 @@ void App::drawLineGraphFromFrequencyMagnitude(RenderDevice* rd) {
     LAUNCH_SHADER("visualizeFrequencyMagnitude.*", args);
 }
 
-void App::updateAudioData() {
-    int sampleCount = g_currentAudioBuffer.size();
-    int freqCount = sampleCount / 2;
-    m_cpuRawAudioData.appendPOD(g_currentAudioBuffer);
+/** Upload a single-row R32F texture from \a data */
+static void uploadRow(const shared_ptr<Texture>& texture, const Array<float>& data) {
+    shared_ptr<CPUPixelTransferBuffer> ptb = CPUPixelTransferBuffer::fromData(data.size(), 1, ImageFormat::R32F(), data.getCArray());
+    texture->update(ptb);
+}
 
-    float sumSquare = 0.0f;
-    for (int i = m_cpuRawAudioData.size() - sampleCount; i < m_cpuRawAudioData.size(); ++i) {
-        sumSquare += square(m_cpuRawAudioData[i]);
-    }
-    float rms = sqrt(sumSquare / sampleCount);
-    m_smoothedRootMeanSquare = lerp(rms, m_smoothedRootMeanSquare, 0.95f);
-
-    int numStoredTimeSlices = m_cpuRawAudioData.size() / sampleCount;
-    shared_ptr<CPUPixelTransferBuffer> ptb = CPUPixelTransferBuffer::fromData(sampleCount, numStoredTimeSlices, ImageFormat::R32F(), m_cpuRawAudioData.getCArray());
-    m_rawAudioTexture->resize(sampleCount, numStoredTimeSlices);
-    m_rawAudioTexture->update(ptb);
-
-    Array<complex> frequency;
-    frequency.resize(freqCount);
-    float* currentRawAudioDataPtr = m_cpuRawAudioData.getCArray() + (m_cpuRawAudioData.size() - sampleCount);
-    memcpy(frequency.getCArray(), currentRawAudioDataPtr, sizeof(float)*sampleCount);
-    rfft((float*)frequency.getCArray(), frequency.size(), FFT_FORWARD);
-    m_cpuFrequencyAudioData.appendPOD(frequency);
-
-    Array<float> frequencyMagnitude;
-    for (complex c : frequency) {
-        frequencyMagnitude.append(cmp_abs(c));
-    }
-    if (isNull(m_fastMovingAverage.gpuData)) {
-        m_fastMovingAverage.init(0.6, frequencyMagnitude, "Fast Freq EWMA");
-        m_slowMovingAverage.init(0.85, frequencyMagnitude, "Slow Freq EWMA");
-        m_glacialMovingAverage.init(0.95, frequencyMagnitude, "Glacial Freq EWMA");
+/** Copy \a count rows starting at texture row \a row (in layer \a layer of an array) from \a data into
+    \a texture, which is bound */
+static void uploadTextureRows(const shared_ptr<Texture>& texture, int layer, int row, int count, const void* data) {
+    const ImageFormat* format = texture->format();
+    if (texture->openGLTextureTarget() == GL_TEXTURE_2D_ARRAY) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, row, layer, texture->width(), count, 1, format->openGLBaseFormat, format->openGLDataFormat, data);
     } else {
-        m_fastMovingAverage.update(frequencyMagnitude);
-        m_slowMovingAverage.update(frequencyMagnitude);
-        m_glacialMovingAverage.update(frequencyMagnitude);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, texture->width(), count, format->openGLBaseFormat, format->openGLDataFormat, data);
     }
+}
 
-    shared_ptr<CPUPixelTransferBuffer> freqPTB = CPUPixelTransferBuffer::fromData(freqCount, numStoredTimeSlices, ImageFormat::RG32F(), m_cpuFrequencyAudioData.getCArray());
+/** Upload the rows \a history has appended since it had \a uploadedRowCount rows (just the last ones that fit,
+    if it got further ahead than that) into layer \a layer of \a texture, made by createHistoryTexture(). Row r
+    of the history goes in texture row r % (height - 1), and row 0 also goes in the extra last row, so filtering
+    from the end of the ring back to its start still finds the right row. Rows the history no longer has (the
+    snapshot only holds the last AudioAnalyzer::snapshotDuration) are cleared rather than left a lap out of
+    date. G3D's Texture::update() can only replace a whole texture, so this goes straight to OpenGL */
+template<class T>
+static void uploadNewRows(const shared_ptr<Texture>& texture, int layer, const AudioHistory<T>& history, uint64_t uploadedRowCount) {
+    const uint64_t rowCount = history.rowCount();
+    const int rowCapacity = texture->height() - 1;
+    uint64_t r = (rowCount > (uint64_t)rowCapacity) ? std::max(uploadedRowCount, rowCount - rowCapacity) : uploadedRowCount;
+    if ((r >= rowCount) || (history.rowSize() == 0)) {
+        return;
+    }
+    const uint64_t oldestRow = (rowCount > (uint64_t)history.rowCapacity()) ? rowCount - history.rowCapacity() : 0;
+    std::vector<T> missingRows;
+
+    const GLenum target = texture->openGLTextureTarget();
+    glBindTexture(target, texture->openGLID());
+    while (r < rowCount) {
+        // Every row the history still has is followed contiguously by the later ones, so each run up to the
+        // end of the ring is one copy
+        const int row = (int)(r % (uint64_t)rowCapacity);
+        uint64_t end = std::min<uint64_t>(rowCount, r + (rowCapacity - row));
+        const T* data;
+        if (r < oldestRow) {
+            end = std::min(end, oldestRow);
+            missingRows.assign((size_t)(end - r) * history.rowSize(), T());
+            data = missingRows.data();
+        } else {
+            data = history.row(r);
+        }
+        uploadTextureRows(texture, layer, row, (int)(end - r), data);
+        if (row == 0) {
+            uploadTextureRows(texture, layer, rowCapacity, 1, data);
+        }
+        r = end;
+    }
+    glBindTexture(target, GL_NONE);
+}
 
-    m_frequencyAudioTexture->resize(freqCount, numStoredTimeSlices);
-    m_frequencyAudioTexture->update(freqPTB);
+void App::updateAudioData() {
+    // All of the analysis happens on m_audioAnalyzer's thread; we only upload its newest results
+    m_audioAnalyzer.setWindow(m_fftWindowIndex);
+    // Every onset, even ones that happened between snapshots
+    OnsetEvent onset;
+    while (m_audioAnalyzer.popOnsetEvent(onset)) {
+        if (onset.band < m_onsetCounts.size()) {
+            ++m_onsetCounts[onset.band];
+        }
+    }
+    if (!m_audioAnalyzer.updateSnapshot()) {
+        return;
+    }
+    const AudioAnalysisSnapshot& snapshot = m_audioAnalyzer.snapshot();
+
+    // Channel 0 goes into the plain 2D textures most shaders read, and every channel into the texture arrays,
+    // one layer each. Only the rows that are new since the last snapshot go up
+    uploadNewRows(m_rawAudioTexture, 0, snapshot.rawHistory[0], m_rawAudioRowCount);
+    uploadNewRows(m_frequencyAudioTexture, 0, snapshot.frequencyHistory[0], m_frequencyAudioRowCount);
+    for (int c = 0; c < snapshot.channelCount(); ++c) {
+        uploadNewRows(m_rawAudioChannelsTexture, c, snapshot.rawHistory[c], m_rawAudioRowCount);
+        uploadNewRows(m_frequencyAudioChannelsTexture, c, snapshot.frequencyHistory[c], m_frequencyAudioRowCount);
+    }
+    m_rawAudioRowCount = snapshot.rawHistory[0].rowCount();
+    m_frequencyAudioRowCount = snapshot.frequencyHistory[0].rowCount();
+
+    uploadNewRows(m_frequencyDbAudioTexture, 0, snapshot.frequencyDbHistory, m_frequencyDbAudioRowCount);
+    m_frequencyDbAudioRowCount = snapshot.frequencyDbHistory.rowCount();
+
+    uploadRow(m_fastMovingAverageTexture, snapshot.fastMovingAverage);
+    uploadRow(m_slowMovingAverageTexture, snapshot.slowMovingAverage);
+    uploadRow(m_glacialMovingAverageTexture, snapshot.glacialMovingAverage);
+    uploadRow(m_fastMovingAverageDbTexture, snapshot.fastMovingAverageDb);
+    uploadRow(m_slowMovingAverageDbTexture, snapshot.slowMovingAverageDb);
+    uploadRow(m_glacialMovingAverageDbTexture, snapshot.glacialMovingAverageDb);
+
+    uploadNewRows(m_slidingSpectrumTexture, 0, snapshot.slidingSpectrumHistory, m_slidingSpectrumRowCount);
+    m_slidingSpectrumRowCount = snapshot.slidingSpectrumHistory.rowCount();
+    uploadNewRows(m_bandTexture, 0, snapshot.bandHistory, m_bandRowCount);
+    m_bandRowCount = snapshot.bandHistory.rowCount();
+    uploadNewRows(m_constantQTexture, 0, snapshot.constantQHistory, m_constantQRowCount);
+    m_constantQRowCount = snapshot.constantQHistory.rowCount();
+}
 
-    if (numStoredTimeSlices == m_maxSavedTimeSlices) {
-        int newTotalSampleCount = sampleCount*(numStoredTimeSlices - 1);
-        int newTotalFrequencyCount = (sampleCount / 2)*(numStoredTimeSlices - 1);
-        for (int i = 0; i < newTotalSampleCount; ++i) {
-            m_cpuRawAudioData[i] = m_cpuRawAudioData[i + sampleCount];
+void App::updateAudioStats() {
+    const AudioCallbackStatistics stats = m_audioCallbackStats.read();
+    const AudioAnalysisSnapshot& snapshot = m_audioAnalyzer.snapshot();
+    const double now = audioCaptureClock();
+    const double latency = now - snapshot.captureTime;
+
+    m_audioStatsLabel[0]->setCaption(format("Callbacks: %llu   Input overflows: %llu   Output underflows: %llu   Queue drops: %llu   Missed blocks: %llu",
+        (unsigned long long)stats.callbackCount, (unsigned long long)stats.inputOverflowCount, (unsigned long long)stats.outputUnderflowCount,
+        (unsigned long long)m_audioBlockQueue.droppedBlockCount(), (unsigned long long)snapshot.missedBlockCount));
+    m_audioStatsLabel[1]->setCaption(format("Callback min/avg/max: %.3f / %.3f / %.3f ms   Jitter avg/max: %.3f / %.3f ms of %.2f ms   Latency: %.1f ms",
+        stats.minDuration * 1000.0, stats.averageDuration * 1000.0, stats.maxDuration * 1000.0,
+        stats.averageJitter * 1000.0, stats.maxJitter * 1000.0, stats.expectedInterval * 1000.0, latency * 1000.0));
+    String onsets = "Onsets per band:";
+    for (int b = 0; b < m_onsetCounts.size(); ++b) {
+        onsets += format(" %d", m_onsetCounts[b]);
+    }
+    m_audioStatsLabel[2]->setCaption(onsets + format("   Dropped: %llu", (unsigned long long)m_audioAnalyzer.droppedOnsetEventCount()));
+
+    if (m_logAudioStats && isNull(m_audioStatsFile)) {
+        m_audioStatsFile = fopen(m_audioStatsFilename.c_str(), "w");
+        if (isNull(m_audioStatsFile)) {
+            debugPrintf("Could not open %s for writing\n", m_audioStatsFilename.c_str());
+            m_logAudioStats = false;
+        } else {
+            fprintf(m_audioStatsFile, "time,callbacks,input_overflows,output_underflows,queue_drops,missed_blocks,"
+                "callback_min_ms,callback_avg_ms,callback_max_ms,expected_interval_ms,jitter_avg_ms,jitter_max_ms,latency_ms\n");
         }
-        m_cpuRawAudioData.resize(newTotalSampleCount);
-        for (int i = 0; i < newTotalFrequencyCount; ++i) {
-            m_cpuFrequencyAudioData[i] = m_cpuFrequencyAudioData[i + freqCount];
+    } else if (!m_logAudioStats && notNull(m_audioStatsFile)) {
+        fclose(m_audioStatsFile);
+        m_audioStatsFile = nullptr;
+    }
+
+    // The min/max values cover one period each, so each CSV row shows the worst case since the previous one
+    if (now - m_audioStatsWindowStart >= m_audioStatsPeriod) {
+        if (notNull(m_audioStatsFile)) {
+            fprintf(m_audioStatsFile, "%.3f,%llu,%llu,%llu,%llu,%llu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f\n",
+                now, (unsigned long long)stats.callbackCount, (unsigned long long)stats.inputOverflowCount,
+                (unsigned long long)stats.outputUnderflowCount, (unsigned long long)m_audioBlockQueue.droppedBlockCount(),
+                (unsigned long long)snapshot.missedBlockCount,
+                stats.minDuration * 1000.0, stats.averageDuration * 1000.0, stats.maxDuration * 1000.0, stats.expectedInterval * 1000.0,
+                stats.averageJitter * 1000.0, stats.maxJitter * 1000.0, latency * 1000.0);
+            fflush(m_audioStatsFile);
         }
-        m_cpuFrequencyAudioData.resize(newTotalFrequencyCount);
+        m_audioCallbackStats.resetWindow();
+        m_audioStatsWindowStart = now;
     }
 }
 
 void App::drawEye(RenderDevice* rd, const Rect2D& rect, const EyeSettings& settings) {
     Args args;
     args.setUniform("iResolution", rect.wh());
-    args.setUniform("iGlobalTime", scene()->time());
+    args.setUniform("iGlobalTime", animationTime());
 
-    float adjustedRMS = m_smoothedRootMeanSquare * (1 - settings.pupilWidth) + settings.pupilWidth;
+    float adjustedRMS = m_audioAnalyzer.snapshot().smoothedRootMeanSquare * (1 - settings.pupilWidth) + settings.pupilWidth;
     args.setUniform("pupilWidth", settings.useRootMeanSquarePupil ? adjustedRMS : settings.pupilWidth);
     args.setUniform("angleOffsetTimeMultiplier", settings.angleOffsetTimeMultiplier);
     args.setMacro("MODE", settings.mode);
@@ -281,7 +734,7 @@ void App::drawEye(RenderDevice* rd, const Rect2D& rect, const EyeSettings& setti
 
 void App::onGraphics3D(RenderDevice* rd, Array<shared_ptr<Surface> >& allSurfaces) {
 
-    if (!scene() || m_cpuRawAudioData.size() == 0) {
+    if (!scene() || m_audioAnalyzer.snapshot().blockCount == 0) {
         return;
     }
 
@@ -321,7 +774,7 @@ void App::onGraphics3D(RenderDevice* rd, Array<shared_ptr<Surface> >& allSurface
 
             Args args;
             args.setUniform("iResolution", rd->viewport().wh());
-            args.setUniform("iGlobalTime", scene()->time());
+            args.setUniform("iGlobalTime", animationTime());
 
             setAudioShaderArgs(args);
             args.setRect(rd->viewport());
@@ -401,16 +854,17 @@ void App::onGraphics2D(RenderDevice* rd, Array<Surface2D::Ref>& posed2D) {
 void App::onSimulation(RealTime rdt, SimTime sdt, SimTime idt) {
     GApp::onSimulation(rdt, sdt, idt);
     updateAudioData();
+    updateAudioStats();
     /* Prototype debug code for particle systems, not used in final product */
     if (m_visualizationMode == VisualizationMode::PARTICLES) {
-        int sampleCount = g_currentAudioBuffer.size();
-        int freqCount = sampleCount / 2;
+        const AudioAnalysisSnapshot& snapshot = m_audioAnalyzer.snapshot();
+        const complex* frequency = snapshot.currentFrequency();
         shared_ptr<ParticleSystem> ps = scene()->typedEntity<ParticleSystem>("pulsar");
         shared_ptr<ParticleSystemModel> model = dynamic_pointer_cast<ParticleSystemModel>(ps->model());
         ParticleSystemModel::Emitter::Specification spec = model->emitterArray()[0]->specification();
         shared_ptr<ParticleMaterial> pm = ParticleMaterial::create(spec.material);
         Random& rng = Random::common();
-        for (int i = m_cpuFrequencyAudioData.size() - freqCount; i < m_cpuFrequencyAudioData.size(); ++i) {
+        for (int i = 0; i < snapshot.frequencyCount(); ++i) {
 
             ParticleSystem::Particle particle;
             particle.emitterIndex = 0;
@@ -426,7 +880,7 @@ void App::onSimulation(RealTime rdt, SimTime sdt, SimTime idt) {
             particle.userdataFloat = 0.0f;
             particle.mass = spec.particleMassDensity * (4.0f / 3.0f) * pif() * particle.radius * particle.radius * particle.radius;
 
-            complex c = m_cpuFrequencyAudioData[i];
+            complex c = frequency[i];
             particle.velocity = Vector3(c.re, c.im, 0.0f) * 10.f;
             
             SimTime absoluteTime = scene()->time();
@@ -13,9 +13,19 @@
 #endif
 #include "RtAudio.h"
 #include "chuck_fft.h"
-
-/** Global array where we dump raw audio data from RtAudio */
-Array<float> g_currentAudioBuffer;
+#include "AudioBlockQueue.h"
+#include "AudioCallbackStats.h"
+#include "AudioAnalyzer.h"
+#include "WavFileAudioSource.h"
+#include "SyntheticAudioSource.h"
+
+/** What the RtAudio callbacks are handed as their userData */
+struct AudioCallbackData {
+    AudioBlockQueue*    queue;
+    AudioCallbackStats* stats;
+
+    AudioCallbackData() : queue(nullptr), stats(nullptr) {}
+};
 
 class App : public GApp {
 protected:
@@ -71,10 +81,6 @@ protected:
     EyeSettings m_secondaryEyeSettings;
 
 
-    /** EWMA of RMS */
-    float m_smoothedRootMeanSquare;
-    
-    
     /** A separate framebuffer to render the eye texture to, just in case we wnat to re-use it */
     shared_ptr<Framebuffer> m_eyeFramebuffer;
 
@@ -82,73 +88,195 @@ protected:
     /** Just a multiplier to stretch out the sndpeek-like visualizations to cover the whole screen */
     float m_waveformWidth;
 
-    /** Exponentially-weighted moving average of frequencies */
-    struct EWMAFrequency {
-        Array<float>        cpuData;
-        shared_ptr<Texture> gpuData;
-        // Update rule: freq_ewma = lerp(freq_current, freq_ewma, alpha)
-        float               alpha;
-
-        void init(float a, const Array<float>& newData, const String& name) {
-            alpha = a;
-            cpuData.appendPOD(newData);
-            gpuData = Texture::createEmpty(name, newData.size(), 1, ImageFormat::R32F());
-            upload();
-        }
+    /** GPU copies of the 3 different rates of exponentially-weighted moving averages of frequencies */
+    shared_ptr<Texture> m_fastMovingAverageTexture;
+    shared_ptr<Texture> m_slowMovingAverageTexture;
+    shared_ptr<Texture> m_glacialMovingAverageTexture;
 
-        void update(const Array<float>& newData) {
-            alwaysAssertM(newData.size() == cpuData.size(), "Must have same size data for EWMAFrequency update");
-            for (int i = 0; i < newData.size(); ++i) {
-                cpuData[i] = lerp(newData[i], cpuData[i], alpha);
-            }
-            upload();
-        }
+    /** The same in dBFS, computed by the analyzer so shaders don't take a log per fetch */
+    shared_ptr<Texture> m_fastMovingAverageDbTexture;
+    shared_ptr<Texture> m_slowMovingAverageDbTexture;
+    shared_ptr<Texture> m_glacialMovingAverageDbTexture;
 
-        void upload() {
-            debugAssert(notNull(gpuData));
-            shared_ptr<CPUPixelTransferBuffer> ptb = CPUPixelTransferBuffer::fromData(cpuData.size(), 1, ImageFormat::R32F(), cpuData.getCArray());
-            gpuData->update(ptb);
-        }
-    };
 
-    /** 3 different rates of exponentially-weighted moving averages of frequencies */
-    EWMAFrequency m_fastMovingAverage;
-    EWMAFrequency m_slowMovingAverage;
-    EWMAFrequency m_glacialMovingAverage;
+    /** DUPLEX opens an output stream alongside the capture stream (and fills it with silence),
+        INPUT_ONLY opens just the capture stream */
+    G3D_DECLARE_ENUM_CLASS(StreamMode,
+        DUPLEX,
+        INPUT_ONLY);
 
+    /** Where captured audio comes from: the default RtAudio input device, a file streamed through an AudioSource,
+        or generated test signals (which also work on machines with no sound card at all) */
+    G3D_DECLARE_ENUM_CLASS(InputSource,
+        DEVICE,
+        FILE,
+        SYNTHETIC);
 
     /** Settings for RtAudio. We never need to change the defaults */
     struct AudioSettings {
+      InputSource inputSource;
+      /** WAV (or raw float PCM) file to stream when inputSource is FILE */
+      String filename;
+      /** Restart the file when it ends */
+      bool loopFile;
+      /** What to generate when inputSource is SYNTHETIC. Its sampleRate is overridden by sampleRate below */
+      SyntheticAudioSource::Settings synthetic;
+      /** Play files and synthetic signals back in real time, or push them through the analysis as fast as they can go */
+      AudioSource::Pacing sourcePacing;
+      /** Channels captured from the device (or produced by the source); each gets its own history and spectrum */
       int numChannels;
       int sampleRate;
+      /** Requested block size; RtAudio may pick a different one, m_audioBlockQueue.framesPerBlock() is what we got */
+      int bufferFrameCount;
       RtAudioFormat rtAudioFormat;
+      /** We never play anything back, so by default don't make the backend run (and synchronize) an output device */
+      StreamMode streamMode;
+      /** Window and hop of the spectrum in samples (see STFTSettings); a long window with overlapping hops
+          resolves bass notes that one FFT per block can't separate */
+      int stftWindowLength;
+      int stftHopLength;
       
       AudioSettings() :
+          inputSource(InputSource::DEVICE),
+          loopFile(true),
+          sourcePacing(AudioSource::Pacing::REAL_TIME),
           numChannels(1),
           sampleRate(48000),
-          rtAudioFormat(RTAUDIO_FLOAT32) {}
+          bufferFrameCount(512),
+          rtAudioFormat(RTAUDIO_FLOAT32),
+          streamMode(StreamMode::INPUT_ONLY),
+          stftWindowLength(4096),
+          stftHopLength(1024) {}
     } m_audioSettings;
 
+    /** How many blocks the queue between the audio callback and updateAudioData() can hold */
+    int m_audioQueueBlockCapacity;
+
+    /** Blocks of raw samples handed from audioCallback (the producer) to updateAudioData (the consumer) */
+    AudioBlockQueue m_audioBlockQueue;
+
+    /** Overflows, timing and jitter of the RtAudio callback, kept by the callback itself */
+    AudioCallbackStats m_audioCallbackStats;
+
+    /** Points the callbacks at m_audioBlockQueue and m_audioCallbackStats */
+    AudioCallbackData m_audioCallbackData;
+
+    /** Producer for m_audioBlockQueue when we're not capturing from RtAudio */
+    shared_ptr<AudioSource> m_audioSource;
+
+    /** Runs all of the analysis of the blocks in m_audioBlockQueue on its own thread */
+    AudioAnalyzer m_audioAnalyzer;
+
     /** How many slices of time to save */
     int m_maxSavedTimeSlices;
 
-    /** CPU storage of raw samples */
-    Array<float> m_cpuRawAudioData;
-    /** CPU storage of fft samples */
-    Array<complex> m_cpuFrequencyAudioData;
-
     /** GPU storage of raw samples */
     shared_ptr<Texture> m_rawAudioTexture;
     /** GPU storage of fft samples */
     shared_ptr<Texture> m_frequencyAudioTexture;
+    /** Their magnitudes in dBFS */
+    shared_ptr<Texture> m_frequencyDbAudioTexture;
+
+    /** Raw and fft samples of every channel, one layer of a 2D texture array per channel.
+        m_rawAudioTexture and m_frequencyAudioTexture hold channel 0 */
+    shared_ptr<Texture> m_rawAudioChannelsTexture;
+    shared_ptr<Texture> m_frequencyAudioChannelsTexture;
+
+    /** Magnitudes of the sliding spectrum's tracked bins (log spaced), one row per hop */
+    shared_ptr<Texture> m_slidingSpectrumTexture;
+
+    /** Window and hop of the sliding spectrum, in samples, and how many bins it tracks between
+        m_slidingSpectrumMinFrequency and m_slidingSpectrumMaxFrequency (Hz) */
+    int                 m_slidingSpectrumWindowLength;
+    int                 m_slidingSpectrumHopLength;
+    int                 m_slidingSpectrumBinCount;
+    float               m_slidingSpectrumMinFrequency;
+    float               m_slidingSpectrumMaxFrequency;
+
+    /** Filterbank band values of channel 0's spectrum, lowest band first, one row per STFT hop */
+    shared_ptr<Texture> m_bandTexture;
+
+    /** How many bands the filterbank splits the spectrum into between m_bandMinFrequency and m_bandMaxFrequency
+        (Hz), and whether they are mel or log spaced */
+    int                 m_bandCount;
+    float               m_bandMinFrequency;
+    float               m_bandMaxFrequency;
+    Filterbank::Scale   m_bandScale;
+
+    /** Constant-Q transform of channel 0, lowest bin first, one row per STFT hop */
+    shared_ptr<Texture> m_constantQTexture;
+
+    /** Bins per octave of the constant-Q transform and the range (Hz) it covers */
+    int                 m_constantQBinsPerOctave;
+    float               m_constantQMinFrequency;
+    float               m_constantQMaxFrequency;
+
+    /** Bands the onset detector watches (the first four reach shaders, one per component of the onset uniforms)
+        and how long their envelopes take to decay by a factor of e, in seconds */
+    OnsetDetector::Settings m_onsetSettings;
+    float               m_onsetDecayTime;
+    /** Onsets taken off of m_audioAnalyzer's queue so far, per band */
+    Array<int>          m_onsetCounts;
+
+    /** The history textures above are rings, so each snapshot only uploads the rows appended since the last
+        one (see uploadNewRows()). These are how many rows of each history have been uploaded; the channel
+        arrays go with m_rawAudioTexture and m_frequencyAudioTexture */
+    uint64_t        m_rawAudioRowCount;
+    uint64_t        m_frequencyAudioRowCount;
+    uint64_t        m_frequencyDbAudioRowCount;
+    uint64_t        m_slidingSpectrumRowCount;
+    uint64_t        m_bandRowCount;
+    uint64_t        m_constantQRowCount;
+
+    /** Choices for the block size and sample rate dropdowns, their current selections, and the channel count box */
+    Array<String>   m_bufferFrameCountOptions;
+    int             m_bufferFrameCountIndex;
+    Array<String>   m_sampleRateOptions;
+    int             m_sampleRateIndex;
+    int             m_numChannelsField;
+
+    /** Choices for the STFT window length ("Block" is one FFT per block) and overlap dropdowns, and their current
+        selections */
+    Array<String>   m_stftWindowLengthOptions;
+    int             m_stftWindowLengthIndex;
+    Array<String>   m_stftOverlapOptions;
+    int             m_stftOverlapIndex;
+
+    /** Choices for the FFT window dropdown, indexed by FFT_WINDOW_*, and the current one */
+    Array<String>   m_fftWindowOptions;
+    int             m_fftWindowIndex;
+
+    /** If true, shaders animate on audioTime() instead of scene()->time(), which drifts relative to the audio clock */
+    bool            m_animateFromAudioClock;
+
+    /** HUD lines showing m_audioCallbackStats */
+    GuiLabel*       m_audioStatsLabel[3];
+
+    /** When true, append a row of m_audioCallbackStats to m_audioStatsFilename every m_audioStatsPeriod seconds */
+    bool            m_logAudioStats;
+    String          m_audioStatsFilename;
+    FILE*           m_audioStatsFile;
+    RealTime        m_audioStatsPeriod;
+    /** audioCaptureClock() when the current min/max window of m_audioCallbackStats started */
+    double          m_audioStatsWindowStart;
+
+    /** Contents of the audio file text box */
+    String          m_audioFilenameField;
 
     /** For a dropdown for choosing shaders in shadertoy mode, this was only used during prototyping */
     Array<String>   m_shadertoyShaders;
     int             m_shadertoyShaderIndex;
 
-    /** Set all our audio textures on \param Args */
+    /** Set all our audio textures and audio clock uniforms on \param Args */
     void setAudioShaderArgs(Args& args);
 
+    /** Current position on the audio stream's clock, in seconds: the newest analyzed block's stream time
+        extrapolated by how long ago it was captured */
+    double audioTime() const;
+
+    /** What iGlobalTime is set to: audioTime() or scene()->time(), depending on m_animateFromAudioClock */
+    SimTime animationTime();
+
     /** Does what it says on the tin. Corresponds to the upper half of sndpeek */
     void drawLineGraphFromRawSamples(RenderDevice* rd);
 
@@ -158,19 +286,66 @@ protected:
     /** Do all of the interaction with RtAudio that we need to to set up realtime audio capture */
     void initializeAudio();
 
+    /** Open and start an RtAudio stream (or an AudioSource) with the current m_audioSettings, and restart m_audioAnalyzer to match.
+        Returns false if the stream couldn't be opened. */
+    bool openAudioStream();
+
+    /** The STFT window and hop from m_audioSettings */
+    STFTSettings stftSettings() const;
+
+    /** The sliding spectrum m_audioAnalyzer should run for audio at \a sampleRate */
+    SlidingSpectrumSettings slidingSpectrumSettings(int sampleRate) const;
+
+    /** The filterbank m_audioAnalyzer should run for audio at \a sampleRate */
+    FilterbankSettings filterbankSettings(int sampleRate) const;
+
+    /** The constant-Q transform m_audioAnalyzer should run for audio at \a sampleRate in blocks of \a framesPerBlock.
+        Drops the lowest octaves if the raw history is too short for their windows */
+    ConstantQSettings constantQSettings(int sampleRate, int framesPerBlock) const;
+
+    /** Start pushing blocks from \a source instead of RtAudio. Called from openAudioStream() */
+    void startAudioSource(const shared_ptr<AudioSource>& source);
+
+    /** Stop and close the RtAudio stream or AudioSource, if any, and stop m_audioAnalyzer */
+    void closeAudioStream();
+
+    /** Close the stream and reopen it with \a settings, reallocating everything that depends on them.
+        Falls back to the previous settings if the new ones can't be opened; returns false in that case. */
+    bool restartAudio(const AudioSettings& settings);
+
+    /** (Re)create every texture whose size depends on the block size, STFT window or channel count */
+    void createAudioTextures();
+
+    /** GUI callback: restartAudio() with the block size, sample rate, channel count and STFT chosen in the debug pane */
+    void applyAudioSettingsFromGUI();
+
+    /** GUI callback: stream the file named in the text box */
+    void playAudioFileFromGUI();
+
+    /** GUI callback: go back to capturing from the default input device */
+    void useLiveInputFromGUI();
+
+    /** GUI callback: switch to the synthetic signal chosen in the debug pane */
+    void useSyntheticInputFromGUI();
+
     /** Draw a single eye using our special eye shader configured with the options passed in as parameters */
     void drawEye(RenderDevice* rd, const Rect2D& rect, const EyeSettings& settings);
 
     /** Called from onInit */
     void makeGUI();
 
-    /** Called once a frame to get the latest audio data and compute statistics such as RMS */
+    /** Called once a frame to pick up the latest snapshot from m_audioAnalyzer and upload it to the GPU */
     void updateAudioData();
 
+    /** Called once a frame to refresh the audio stats HUD and, once a period, log them and start a new window */
+    void updateAudioStats();
+
 
 public:
 
-    App(const GApp::Settings& settings = GApp::Settings());
+    /** If \a audioFilename is not empty, stream it instead of capturing from the default input device.
+        The special name "--synthetic" selects the synthetic signal generator. */
+    App(const GApp::Settings& settings = GApp::Settings(), const String& audioFilename = "");
 
     virtual void onInit() override;
     virtual void onGraphics3D(RenderDevice* rd, Array< shared_ptr<Surface> >& surface) override;
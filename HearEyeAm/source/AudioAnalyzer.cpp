@@ -0,0 +1,394 @@
+/** \file AudioAnalyzer.cpp */
+#include "AudioAnalyzer.h"
+#include <chrono>
+
+const float AudioAnalyzer::minDecibels = -120.0f;
+
+const RealTime AudioAnalyzer::snapshotDuration = 0.25;
+
+/** Rows a snapshot's history needs to cover snapshotDuration when a row is appended every \a rowDuration
+    seconds, and at least \a rowsPerBlock, the most one block can append */
+static int snapshotRowCount(RealTime rowDuration, int rowsPerBlock) {
+    return max(rowsPerBlock, iCeil(AudioAnalyzer::snapshotDuration / rowDuration)) + 1;
+}
+
+/** \a count magnitudes in dB relative to \a fullScaleMagnitude, floored at AudioAnalyzer::minDecibels */
+static void toDecibels(const float* magnitudes, int count, float fullScaleMagnitude, float* decibels) {
+    const float floorMagnitude = fullScaleMagnitude * pow(10.0f, AudioAnalyzer::minDecibels / 20.0f);
+    for (int i = 0; i < count; ++i) {
+        decibels[i] = 20.0f * log10f(max(magnitudes[i], floorMagnitude) / fullScaleMagnitude);
+    }
+}
+
+AudioAnalyzer::AudioAnalyzer() :
+    m_queue(nullptr),
+    m_samplesPerBlock(0),
+    m_channelCount(0),
+    m_historyRows(0),
+    m_windowLength(0),
+    m_hopLength(0),
+    m_fftPlan(nullptr),
+    m_fftWindow(FFT_WINDOW_HANNING),
+    m_pollInterval(0.001),
+    m_running(false),
+    m_nextSequence(0),
+    m_fftWindowTable(nullptr),
+    m_currentFullScaleMagnitude(0.5f),
+    m_samplesUntilHop(0),
+    m_slidingHopLength(0),
+    m_samplesUntilSlidingHop(0),
+    m_secondsPerSample(0.0) {}
+
+
+AudioAnalyzer::~AudioAnalyzer() {
+    stop();
+    fft_plan_destroy(m_fftPlan);
+}
+
+
+void AudioAnalyzer::start(AudioBlockQueue* queue, int historyRows, RealTime blockDuration, const STFTSettings& stft, const SlidingSpectrumSettings& slidingSpectrum,
+                          const FilterbankSettings& filterbank, const ConstantQSettings& constantQ,
+                          const OnsetDetector::Settings& onsets) {
+    stop();
+    m_queue = queue;
+    m_samplesPerBlock = queue->framesPerBlock();
+    m_channelCount = queue->channelCount();
+    m_historyRows = historyRows;
+    // Poll a few times per block so we add well under a block of latency
+    m_pollInterval = min(0.001, blockDuration / 4.0);
+    m_nextSequence = 0;
+
+    alwaysAssertM(supportsSTFT(m_samplesPerBlock, stft), format("A %d-sample STFT window is not supported", stft.windowLength));
+    m_windowLength = (stft.windowLength > 0) ? stft.windowLength : m_samplesPerBlock;
+    m_hopLength = (stft.hopLength > 0) ? stft.hopLength : m_windowLength;
+    // Frames are read in place from the raw history, which has to reach back a whole window from the end of
+    // the newest block
+    alwaysAssertM((int64)historyRows * m_samplesPerBlock >= m_windowLength + m_samplesPerBlock,
+        format("%d rows of %d-sample blocks can't hold a %d-sample STFT window", historyRows, m_samplesPerBlock, m_windowLength));
+    // The first frame ends once a whole window has arrived
+    m_samplesUntilHop = m_windowLength;
+    m_frameEnds.clear();
+    const int maxFramesPerBlock = m_samplesPerBlock / m_hopLength + 1;
+    m_frameEnds.reserve(maxFramesPerBlock);
+
+    // One thread per channel and frame at most; the analysis thread itself takes one of them
+    const int hardwareThreads = max(1, (int)std::thread::hardware_concurrency());
+    const int workerCount = min(m_channelCount * maxFramesPerBlock, hardwareThreads) - 1;
+    if (workerCount > 0) {
+        m_channelPool.reset(new ThreadPool(workerCount));
+    } else {
+        m_channelPool.reset();
+    }
+
+    int freqCount = m_windowLength / 2;
+    m_fftWork.resize(freqCount * m_channelCount * maxFramesPerBlock);
+    m_frequencyMagnitude.resize(freqCount);
+    m_fastMovingAverage.init(0.6f, freqCount);
+    m_slowMovingAverage.init(0.85f, freqCount);
+    m_glacialMovingAverage.init(0.95f, freqCount);
+
+    // Twiddles and windows for this window length, shared read-only by every channel
+    fft_plan_destroy(m_fftPlan);
+    m_fftPlan = fft_plan_create(freqCount);
+    alwaysAssertM(notNull(m_fftPlan), "Could not create the FFT plan");
+    // rfft() scales by 1/N, so a unit sine under window w comes out as mean(w) / 2
+    for (int w = 0; w < FFT_WINDOW_COUNT; ++w) {
+        const float* table = fft_plan_window(m_fftPlan, w);
+        double sum = 0.0;
+        for (int i = 0; i < m_windowLength; ++i) {
+            sum += table ? table[i] : 1.0;
+        }
+        m_fullScaleMagnitude[w] = (float)(0.5 * sum / m_windowLength);
+    }
+
+    m_slidingHopLength = slidingSpectrum.hopLength;
+    m_samplesUntilSlidingHop = slidingSpectrum.hopLength;
+    if (slidingSpectrum.windowLength > 0) {
+        alwaysAssertM(slidingSpectrum.hopLength > 0, "The sliding spectrum needs a hop length");
+        m_slidingDFT.init(slidingSpectrum.windowLength, slidingSpectrum.hopLength, slidingSpectrum.bins);
+    } else {
+        m_slidingDFT.init(0, 0, std::vector<int>());
+    }
+
+    if (filterbank.bandCount > 0) {
+        alwaysAssertM(filterbank.sampleRate > 0.0, "The filterbank needs the sample rate");
+        m_filterbank.init(freqCount, filterbank.sampleRate / m_windowLength, filterbank.bandCount, filterbank.minFrequency, filterbank.maxFrequency, filterbank.scale);
+    } else {
+        m_filterbank.init(freqCount, 0.0, 0, 0.0, 0.0);
+    }
+
+    if (constantQ.binsPerOctave > 0) {
+        alwaysAssertM(constantQ.sampleRate > 0.0, "The constant-Q transform needs the sample rate");
+        m_constantQ.init(constantQ.sampleRate, constantQ.minFrequency, constantQ.maxFrequency, constantQ.binsPerOctave);
+    } else {
+        m_constantQ.init(0.0, 0.0, 0.0, 0);
+    }
+    alwaysAssertM((int64)historyRows * m_samplesPerBlock >= m_constantQ.fftLength() + m_samplesPerBlock,
+        format("%d rows of %d-sample blocks can't hold a %d-sample constant-Q window", historyRows, m_samplesPerBlock, m_constantQ.fftLength()));
+
+    m_secondsPerSample = blockDuration / m_samplesPerBlock;
+    m_onsetDetector.init(freqCount, 1.0 / (m_windowLength * m_secondsPerSample), m_hopLength * m_secondsPerSample, onsets);
+    m_onsetEvents.init(256);
+
+    // Preallocate every snapshot so publishing never allocates. The snapshots only hold the last
+    // snapshotDuration of each history, and so does m_current except for the raw samples (see m_current)
+    const int blockRows = min(historyRows, snapshotRowCount(blockDuration, 1));
+    const int frameRows = snapshotRowCount(m_hopLength * m_secondsPerSample, m_samplesPerBlock / m_hopLength + 1);
+    const int slidingRows = (m_slidingHopLength > 0) ? snapshotRowCount(m_slidingHopLength * m_secondsPerSample, m_samplesPerBlock / m_slidingHopLength + 1) : 1;
+    m_current = AudioAnalysisSnapshot();
+    m_current.channelRootMeanSquare.resize(m_channelCount);
+    m_current.channelRootMeanSquare.setAll(0.0f);
+    m_current.rawHistory.resize(m_channelCount);
+    m_current.frequencyHistory.resize(m_channelCount);
+    for (int c = 0; c < m_channelCount; ++c) {
+        m_current.rawHistory[c].init(m_samplesPerBlock, blockRows);
+        m_current.frequencyHistory[c].init(freqCount, frameRows);
+    }
+    m_current.slidingSpectrumHistory.init(m_slidingDFT.binCount(), slidingRows);
+    m_current.bandHistory.init(m_filterbank.bandCount(), frameRows);
+    m_current.constantQHistory.init(m_constantQ.binCount(), frameRows);
+    m_current.onsetBands.resize(m_onsetDetector.bandCount());
+    m_current.frequencyDbHistory.init(freqCount, frameRows);
+    m_current.fastMovingAverage = m_fastMovingAverage.data;
+    m_current.slowMovingAverage = m_slowMovingAverage.data;
+    m_current.glacialMovingAverage = m_glacialMovingAverage.data;
+    m_current.fastMovingAverageDb.resize(freqCount);
+    m_current.fastMovingAverageDb.setAll(minDecibels);
+    m_current.slowMovingAverageDb = m_current.fastMovingAverageDb;
+    m_current.glacialMovingAverageDb = m_current.fastMovingAverageDb;
+    for (int i = 0; i < 3; ++i) {
+        m_snapshots.slot(i) = m_current;
+    }
+    m_snapshots.reset();
+    for (int c = 0; c < m_channelCount; ++c) {
+        m_current.rawHistory[c].init(m_samplesPerBlock, historyRows);
+    }
+
+    m_running = true;
+    m_thread = std::thread(&AudioAnalyzer::threadMain, this);
+}
+
+
+void AudioAnalyzer::stop() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+
+void AudioAnalyzer::threadMain() {
+    while (m_running) {
+        int newBlockCount = 0;
+        while (const float* block = m_queue->front()) {
+            const AudioBlockInfo& info = m_queue->frontInfo();
+            if (info.sequence != m_nextSequence) {
+                m_current.missedBlockCount += info.sequence - m_nextSequence;
+            }
+            m_nextSequence = info.sequence + 1;
+            m_current.sequence = info.sequence;
+            m_current.streamTime = info.streamTime;
+            m_current.captureTime = info.captureTime;
+            analyzeBlock(block);
+            m_queue->pop();
+            ++newBlockCount;
+        }
+
+        if (newBlockCount > 0) {
+            publish();
+        } else {
+            std::this_thread::sleep_for(std::chrono::duration<double>(m_pollInterval));
+        }
+    }
+}
+
+
+void AudioAnalyzer::analyzeBlock(const float* block) {
+    const int sampleCount = m_samplesPerBlock;
+    const int channelCount = m_channelCount;
+
+    // Deinterleave once, straight into each channel's next history row
+    if (channelCount == 1) {
+        memcpy(m_current.rawHistory[0].beginRow(), block, sizeof(float) * sampleCount);
+    } else {
+        for (int c = 0; c < channelCount; ++c) {
+            float* dst = m_current.rawHistory[c].beginRow();
+            for (int i = 0; i < sampleCount; ++i) {
+                dst[i] = block[i * channelCount + c];
+            }
+        }
+    }
+    for (int c = 0; c < channelCount; ++c) {
+        m_current.rawHistory[c].endRow();
+    }
+
+    // STFT frames ending in this block
+    m_frameEnds.clear();
+    while (m_samplesUntilHop <= sampleCount) {
+        m_frameEnds.push_back(m_samplesUntilHop);
+        m_samplesUntilHop += m_hopLength;
+    }
+    m_samplesUntilHop -= sampleCount;
+
+    const int window = ((m_fftWindow >= 0) && (m_fftWindow < FFT_WINDOW_COUNT)) ? m_fftWindow.load() : FFT_WINDOW_NONE;
+    m_fftWindowTable = fft_plan_window(m_fftPlan, window);
+    m_currentFullScaleMagnitude = m_fullScaleMagnitude[window];
+    // Frames are tasks of their own as well as channels, so a short hop (or a mono stream) spreads across
+    // threads too
+    const int frameCount = (int)m_frameEnds.size();
+    const int taskCount = channelCount * max(1, frameCount);
+    if (m_channelPool) {
+        m_channelPool->parallelFor(taskCount, [this](int task) { analyzeChannelFrame(task); });
+    } else {
+        for (int task = 0; task < taskCount; ++task) {
+            analyzeChannelFrame(task);
+        }
+    }
+    for (int c = 0; c < channelCount; ++c) {
+        m_current.frequencyHistory[c].endRows(frameCount);
+    }
+
+    if (m_constantQ.binCount() > 0) {
+        analyzeConstantQ();
+    }
+
+    if (m_slidingDFT.binCount() > 0) {
+        analyzeSlidingSpectrum(m_current.rawHistory[0].newestRow());
+    }
+
+    m_current.rootMeanSquare = m_current.channelRootMeanSquare[0];
+    m_current.smoothedRootMeanSquare = lerp(m_current.rootMeanSquare, m_current.smoothedRootMeanSquare, 0.95f);
+
+    // One EWMA step, one row of dB and of bands, and one onset detector update per new spectrum of channel 0,
+    // oldest first
+    const AudioHistory<complex>& frequencyHistory = m_current.frequencyHistory[0];
+    const uint64 firstRow = frequencyHistory.rowCount() - m_frameEnds.size();
+    for (size_t f = 0; f < m_frameEnds.size(); ++f) {
+        const complex* frequency = frequencyHistory.row(firstRow + f);
+        for (int i = 0; i < m_frequencyMagnitude.size(); ++i) {
+            m_frequencyMagnitude[i] = cmp_abs(frequency[i]);
+        }
+        m_fastMovingAverage.update(m_frequencyMagnitude);
+        m_slowMovingAverage.update(m_frequencyMagnitude);
+        m_glacialMovingAverage.update(m_frequencyMagnitude);
+        toDecibels(m_frequencyMagnitude.getCArray(), m_frequencyMagnitude.size(), m_currentFullScaleMagnitude, m_current.frequencyDbHistory.beginRow());
+        m_current.frequencyDbHistory.endRow();
+        if (m_filterbank.bandCount() > 0) {
+            m_filterbank.apply(m_frequencyMagnitude.getCArray(), m_current.bandHistory.beginRow());
+            m_current.bandHistory.endRow();
+        }
+        if (m_onsetDetector.bandCount() > 0) {
+            const double frameEndTime = m_current.streamTime + m_frameEnds[f] * m_secondsPerSample;
+            m_onsetDetector.update(m_frequencyMagnitude.getCArray(), m_currentFullScaleMagnitude, frameEndTime);
+            for (size_t e = 0; e < m_onsetDetector.events().size(); ++e) {
+                m_onsetEvents.push(m_onsetDetector.events()[e]);
+            }
+        }
+    }
+    for (int b = 0; b < m_onsetDetector.bandCount(); ++b) {
+        m_current.onsetBands[b] = m_onsetDetector.state(b);
+    }
+
+    ++m_current.blockCount;
+}
+
+
+void AudioAnalyzer::analyzeChannelFrame(int task) {
+    // Each task only touches its own channel's histories, its own row of them and its own slice of m_fftWork
+    const int frameCount = (int)m_frameEnds.size();
+    const int channel = task / max(1, frameCount);
+    const int frame = task % max(1, frameCount);
+    const int sampleCount = m_samplesPerBlock;
+    const AudioHistory<float>& rawHistory = m_current.rawHistory[channel];
+
+    if (frame == 0) {
+        const float* samples = rawHistory.newestRow();
+        float sumSquare = 0.0f;
+        for (int i = 0; i < sampleCount; ++i) {
+            sumSquare += square(samples[i]);
+        }
+        m_current.channelRootMeanSquare[channel] = sqrt(sumSquare / sampleCount);
+    }
+
+    if (frame < frameCount) {
+        AudioHistory<complex>& frequencyHistory = m_current.frequencyHistory[channel];
+        complex* work = m_fftWork.getCArray() + task * frequencyHistory.rowSize();
+        // Sample index (across the whole history) where the newest block starts
+        const uint64 blockStart = (rawHistory.rowCount() - 1) * (uint64)sampleCount;
+        // Straight from the raw history, whose rows are contiguous, into the frame's frequency history row, so
+        // neither the samples nor the spectrum are copied; the FFT's first stage applies the window as it
+        // reads the samples
+        const float* samples = rawHistory.element(blockStart + m_frameEnds[frame] - m_windowLength);
+        rfft_stockham_windowed(m_fftPlan, samples, m_fftWindowTable, (float*)frequencyHistory.beginRow(frame), (float*)work);
+    }
+}
+
+
+void AudioAnalyzer::analyzeConstantQ() {
+    const AudioHistory<float>& rawHistory = m_current.rawHistory[0];
+    AudioHistory<complex>& history = m_current.constantQHistory;
+    const int length = m_constantQ.fftLength();
+    const uint64 blockStart = (rawHistory.rowCount() - 1) * (uint64)m_samplesPerBlock;
+    for (size_t f = 0; f < m_frameEnds.size(); ++f) {
+        // Same rows as the STFT, but the constant-Q window is usually longer; until a whole one has arrived
+        // the row is left silent
+        const uint64 end = blockStart + m_frameEnds[f];
+        if (end >= (uint64)length) {
+            m_constantQ.transform(rawHistory.element(end - length), history.beginRow());
+        } else {
+            memset(history.beginRow(), 0, sizeof(complex) * history.rowSize());
+        }
+        history.endRow();
+    }
+}
+
+
+void AudioAnalyzer::analyzeSlidingSpectrum(const float* samples) {
+    AudioHistory<float>& history = m_current.slidingSpectrumHistory;
+    int i = 0;
+    while (i < m_samplesPerBlock) {
+        const int count = min(m_samplesPerBlock - i, m_samplesUntilSlidingHop);
+        m_slidingDFT.update(samples + i, count);
+        i += count;
+        m_samplesUntilSlidingHop -= count;
+        if (m_samplesUntilSlidingHop == 0) {
+            m_slidingDFT.magnitudes(history.beginRow());
+            history.endRow();
+            m_samplesUntilSlidingHop = m_slidingHopLength;
+        }
+    }
+}
+
+
+void AudioAnalyzer::publish() {
+    AudioAnalysisSnapshot& s = m_snapshots.back();
+    s.sequence                  = m_current.sequence;
+    s.blockCount                = m_current.blockCount;
+    s.missedBlockCount          = m_current.missedBlockCount;
+    s.streamTime                = m_current.streamTime;
+    s.captureTime               = m_current.captureTime;
+    s.rootMeanSquare            = m_current.rootMeanSquare;
+    s.smoothedRootMeanSquare    = m_current.smoothedRootMeanSquare;
+    // Same sizes every time, so these copies never reallocate
+    memcpy(s.channelRootMeanSquare.getCArray(), m_current.channelRootMeanSquare.getCArray(), sizeof(float) * m_channelCount);
+    memcpy(s.fastMovingAverage.getCArray(), m_fastMovingAverage.data.getCArray(), sizeof(float) * m_fastMovingAverage.data.size());
+    memcpy(s.slowMovingAverage.getCArray(), m_slowMovingAverage.data.getCArray(), sizeof(float) * m_slowMovingAverage.data.size());
+    memcpy(s.glacialMovingAverage.getCArray(), m_glacialMovingAverage.data.getCArray(), sizeof(float) * m_glacialMovingAverage.data.size());
+    // Once per publish rather than per hop, since only the newest averages are published
+    toDecibels(m_fastMovingAverage.data.getCArray(), m_fastMovingAverage.data.size(), m_currentFullScaleMagnitude, s.fastMovingAverageDb.getCArray());
+    toDecibels(m_slowMovingAverage.data.getCArray(), m_slowMovingAverage.data.size(), m_currentFullScaleMagnitude, s.slowMovingAverageDb.getCArray());
+    toDecibels(m_glacialMovingAverage.data.getCArray(), m_glacialMovingAverage.data.size(), m_currentFullScaleMagnitude, s.glacialMovingAverageDb.getCArray());
+    // Only the rows this slot hasn't seen yet
+    for (int c = 0; c < m_channelCount; ++c) {
+        s.rawHistory[c].syncFrom(m_current.rawHistory[c]);
+        s.frequencyHistory[c].syncFrom(m_current.frequencyHistory[c]);
+    }
+    s.slidingSpectrumHistory.syncFrom(m_current.slidingSpectrumHistory);
+    s.frequencyDbHistory.syncFrom(m_current.frequencyDbHistory);
+    s.bandHistory.syncFrom(m_current.bandHistory);
+    s.constantQHistory.syncFrom(m_current.constantQHistory);
+    for (int b = 0; b < m_current.onsetBands.size(); ++b) {
+        s.onsetBands[b] = m_current.onsetBands[b];
+    }
+    m_snapshots.publish();
+}
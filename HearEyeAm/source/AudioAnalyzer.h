@@ -0,0 +1,372 @@
+/**
+  \file AudioAnalyzer.h
+
+  Audio analysis (RMS, FFT, moving averages, history) on its own thread.
+ */
+#ifndef AudioAnalyzer_h
+#define AudioAnalyzer_h
+
+#include <G3D/G3DAll.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "chuck_fft.h"
+#include "AudioBlockQueue.h"
+#include "AudioHistory.h"
+#include "TripleBuffer.h"
+#include "ThreadPool.h"
+#include "SlidingDFT.h"
+#include "Filterbank.h"
+#include "ConstantQ.h"
+#include "OnsetDetector.h"
+#include "EventQueue.h"
+
+/** Exponentially-weighted moving average of frequencies */
+struct EWMAFrequency {
+    Array<float>        data;
+    // Update rule: freq_ewma = lerp(freq_current, freq_ewma, alpha)
+    float               alpha;
+
+    void init(float a, int size) {
+        alpha = a;
+        data.resize(size);
+        data.setAll(0.0f);
+    }
+
+    void update(const Array<float>& newData) {
+        alwaysAssertM(newData.size() == data.size(), "Must have same size data for EWMAFrequency update");
+        for (int i = 0; i < newData.size(); ++i) {
+            data[i] = lerp(newData[i], data[i], alpha);
+        }
+    }
+};
+
+/** Window and hop of AudioAnalyzer's short-time Fourier transform, which fills frequencyHistory independently of
+    the block size: every hopLength samples, the last windowLength samples of each channel are transformed */
+struct STFTSettings {
+    /** Samples per FFT; 0 means the block size */
+    int                 windowLength;
+    /** Samples between spectra (windowLength / 4 is 75% overlap); 0 means windowLength, i.e. no overlap.
+        Need not divide the block size */
+    int                 hopLength;
+
+    STFTSettings() : windowLength(0), hopLength(0) {}
+
+    STFTSettings(int windowLength, int hopLength) : windowLength(windowLength), hopLength(hopLength) {}
+};
+
+/** What AudioAnalyzer's sliding spectrum of channel 0 tracks (see SlidingDFT) */
+struct SlidingSpectrumSettings {
+    /** Samples in the analysis window; 0 turns the sliding spectrum off */
+    int                 windowLength;
+    /** Samples between rows of AudioAnalysisSnapshot::slidingSpectrumHistory; need not divide the block size,
+        but should share a large power of 2 with windowLength (see SlidingDFT) */
+    int                 hopLength;
+    /** Bins of a windowLength-sample DFT to track, Hann windowed. Each costs up to 3 tracked bins (itself and
+        its neighbours, which adjacent bins share), and each tracked bin 2 real multiply-adds per sample plus
+        windowLength / gcd(windowLength, hopLength) complex adds per hop */
+    std::vector<int>    bins;
+
+    SlidingSpectrumSettings() : windowLength(0), hopLength(0) {}
+};
+
+/** AudioAnalyzer's perceptual bands of channel 0's spectrum (see Filterbank) */
+struct FilterbankSettings {
+    /** Number of bands; 0 turns the filterbank off */
+    int                 bandCount;
+    /** Sample rate of the input, which places the STFT's bins in Hz */
+    double              sampleRate;
+    /** Range the bands cover, in Hz */
+    double              minFrequency;
+    double              maxFrequency;
+    Filterbank::Scale   scale;
+
+    FilterbankSettings() : bandCount(0), sampleRate(0.0), minFrequency(0.0), maxFrequency(0.0), scale(Filterbank::MEL) {}
+};
+
+/** AudioAnalyzer's constant-Q transform of channel 0 (see ConstantQ) */
+struct ConstantQSettings {
+    /** Bins per octave; 0 turns the transform off */
+    int                 binsPerOctave;
+    double              sampleRate;
+    /** Lowest and (at most) highest bin frequency, in Hz */
+    double              minFrequency;
+    double              maxFrequency;
+
+    ConstantQSettings() : binsPerOctave(0), sampleRate(0.0), minFrequency(0.0), maxFrequency(0.0) {}
+};
+
+/** Everything the renderer needs from the analysis of the audio up to (and including) block \a sequence.
+    Published by AudioAnalyzer; never modified while the renderer holds it.
+
+    The histories only reach back AudioAnalyzer::snapshotDuration seconds: enough for the renderer to append the
+    rows that are new since the snapshot it held before to its own longer history (the ring textures), but not a
+    whole display's worth, since there are three snapshots per channel and a spectrum row can be tens of KB. */
+struct AudioAnalysisSnapshot {
+    /** Sequence number of the newest block included */
+    uint64              sequence;
+
+    /** Number of blocks analyzed so far. Zero until the first block arrives */
+    uint64              blockCount;
+
+    /** Number of blocks that never reached the analyzer, detected from gaps in the sequence numbers */
+    uint64              missedBlockCount;
+
+    /** AudioBlockInfo::streamTime and captureTime of the newest block */
+    double              streamTime;
+    double              captureTime;
+
+    /** RMS of channel 0 of the newest block */
+    float               rootMeanSquare;
+
+    /** EWMA of RMS */
+    float               smoothedRootMeanSquare;
+
+    /** RMS of the newest block, per channel */
+    Array<float>        channelRootMeanSquare;
+
+    /** 3 different rates of exponentially-weighted moving averages of channel 0's frequency magnitudes, updated
+        once per STFT hop */
+    Array<float>        fastMovingAverage;
+    Array<float>        slowMovingAverage;
+    Array<float>        glacialMovingAverage;
+
+    /** The same moving averages in dBFS (see frequencyDbHistory) */
+    Array<float>        fastMovingAverageDb;
+    Array<float>        slowMovingAverageDb;
+    Array<float>        glacialMovingAverageDb;
+
+    /** Raw samples, one history per channel with one row per block (rowCount() is blockCount) */
+    Array< AudioHistory<float> >    rawHistory;
+
+    /** fft samples, one history per channel with one row per STFT hop */
+    Array< AudioHistory<complex> >  frequencyHistory;
+
+    /** Magnitudes of channel 0's spectra in dB relative to full scale: a full-scale sine on a bin is 0 dB whatever
+        the window and its length. Floored at AudioAnalyzer::minDecibels, one row per STFT hop */
+    AudioHistory<float>             frequencyDbHistory;
+
+    /** Magnitudes of the sliding spectrum's tracked bins for channel 0, one row per hop. Rows are empty when
+        the sliding spectrum is off */
+    AudioHistory<float>             slidingSpectrumHistory;
+
+    /** Filterbank band values of channel 0's spectrum, lowest band first, one row per STFT hop. Rows are empty
+        when the filterbank is off */
+    AudioHistory<float>             bandHistory;
+
+    /** Constant-Q transform of channel 0, lowest bin first, one row per STFT hop. Rows are empty when the
+        transform is off */
+    AudioHistory<complex>           constantQHistory;
+
+    /** Where each band of the onset detector stands as of the newest STFT hop (empty when it is off). The onsets
+        themselves come through AudioAnalyzer::popOnsetEvent() so none are missed between snapshots */
+    Array<OnsetDetector::BandState> onsetBands;
+
+    AudioAnalysisSnapshot() : sequence(0), blockCount(0), missedBlockCount(0), streamTime(0.0), captureTime(0.0),
+        rootMeanSquare(0.0f), smoothedRootMeanSquare(0.0f) {}
+
+    int channelCount() const {
+        return rawHistory.size();
+    }
+
+    /** Samples per channel per block */
+    int samplesPerBlock() const {
+        return rawHistory[0].rowSize();
+    }
+
+    /** Bins per spectrum: half the STFT window */
+    int frequencyCount() const {
+        return frequencyHistory[0].rowSize();
+    }
+
+    /** Newest row of frequencyHistory[channel] */
+    const complex* currentFrequency(int channel = 0) const {
+        return frequencyHistory[channel].newestRow();
+    }
+};
+
+/**
+  Drains blocks from an AudioBlockQueue on a dedicated thread, analyzes each one exactly once, and publishes
+  AudioAnalysisSnapshots through a triple buffer so the render thread can grab the latest one without waiting
+  and a GPU stall can never hold up the analysis.
+ */
+class AudioAnalyzer {
+protected:
+
+    AudioBlockQueue*                        m_queue;
+    /** Samples per channel per block */
+    int                                     m_samplesPerBlock;
+    int                                     m_channelCount;
+    /** Rows of history the renderer keeps, as passed to start() */
+    int                                     m_historyRows;
+
+    /** STFT window and hop in samples, and precomputed FFT tables for m_windowLength real samples, created
+        in start() */
+    int                                     m_windowLength;
+    int                                     m_hopLength;
+    fft_plan*                               m_fftPlan;
+
+    /** FFT_WINDOW_* applied to every block before its FFT. Set from any thread; read once per block */
+    std::atomic<int>                        m_fftWindow;
+
+    /** How long the analysis thread sleeps when it has drained the queue */
+    RealTime                                m_pollInterval;
+
+    std::thread                             m_thread;
+    std::atomic<bool>                       m_running;
+
+    TripleBuffer<AudioAnalysisSnapshot>     m_snapshots;
+
+    // Everything below is owned by the analysis thread while it is running
+
+    /** The up-to-date state; copied into a snapshot slot at every publish. Its raw histories are the only ones
+        with all historyRows() rows, since STFT and constant-Q frames are read from them in place; every other
+        history is as short as the snapshots' */
+    AudioAnalysisSnapshot                   m_current;
+    EWMAFrequency                           m_fastMovingAverage;
+    EWMAFrequency                           m_slowMovingAverage;
+    EWMAFrequency                           m_glacialMovingAverage;
+
+    /** Sequence number we expect on the next block taken off of the queue */
+    uint64                                  m_nextSequence;
+
+    /** m_fftPlan's table for m_fftWindow as of the current block (nullptr for none) */
+    const float*                            m_fftWindowTable;
+
+    /** Magnitude of a full-scale sine on a bin with each FFT_WINDOW_* window (half the window's mean), and with
+        the current block's window: 0 dBFS */
+    float                                   m_fullScaleMagnitude[FFT_WINDOW_COUNT];
+    float                                   m_currentFullScaleMagnitude;
+
+    /** Samples of the next block before the end of the next STFT frame (may be more than a block away) */
+    int                                     m_samplesUntilHop;
+    /** Where the STFT frames of the current block end, in samples from its start; at most one per hop */
+    std::vector<int>                        m_frameEnds;
+
+    /** Runs the per-channel and per-frame part of analyzeBlock() for several channels and STFT frames at once.
+        Only created when a block can have more than one of them */
+    std::unique_ptr<ThreadPool>             m_channelPool;
+
+    /** Long-window, short-hop spectrum of a few bins of channel 0, and how many samples until its next row */
+    SlidingDFT                              m_slidingDFT;
+    int                                     m_slidingHopLength;
+    int                                     m_samplesUntilSlidingHop;
+
+    /** Folds each new spectrum of channel 0 into the rows of bandHistory */
+    Filterbank                              m_filterbank;
+
+    /** Transforms the samples of channel 0 leading up to each STFT frame end into a row of constantQHistory */
+    ConstantQ                               m_constantQ;
+
+    /** Runs on every spectrum of channel 0, and hands the onsets it finds to the render thread */
+    OnsetDetector                           m_onsetDetector;
+    EventQueue<OnsetEvent>                  m_onsetEvents;
+    /** Block duration / samples per block, to put each STFT frame on the stream clock */
+    double                                  m_secondsPerSample;
+
+    /** Scratch space, allocated once in start() so analyzing a block never allocates.
+        m_fftWork holds the FFT's scratch space for each channel and frame of a block, so they can all be
+        transformed concurrently */
+    Array<complex>                          m_fftWork;
+    Array<float>                            m_frequencyMagnitude;
+
+    void threadMain();
+
+    /** Analyze one block of interleaved samples and append it to the histories */
+    void analyzeBlock(const float* block);
+
+    /** Per-channel part of analyzeBlock(), split into one task per channel and STFT frame ending in the newest
+        block (or just one per channel when none does): the channel's RMS, and a windowed FFT of the frame read in
+        place from the raw history into its row of the frequency history, which analyzeBlock() then commits */
+    void analyzeChannelFrame(int task);
+
+    /** Append a row of m_constantQ for every STFT frame ending in the newest block of channel 0 */
+    void analyzeConstantQ();
+
+    /** Push a block of channel 0 through m_slidingDFT, appending a row for every hop completed */
+    void analyzeSlidingSpectrum(const float* samples);
+
+    /** Copy m_current into the back snapshot and hand it to the reader */
+    void publish();
+
+public:
+
+    /** Floor of every dB value, so silence doesn't come out as -infinity */
+    static const float                      minDecibels;
+
+    /** Seconds of rows each snapshot's histories hold. The renderer only misses rows if it goes this long
+        without picking up a snapshot */
+    static const RealTime                   snapshotDuration;
+
+    AudioAnalyzer();
+    ~AudioAnalyzer();
+
+    /** True if start() can analyze blocks of \a framesPerBlock frames with \a stft: the STFT window (the block
+        size, by default) must be an even number of samples whose half is a product of 2s, 3s and 5s (e.g. 480,
+        512 or 4096) */
+    static bool supportsSTFT(int framesPerBlock, const STFTSettings& stft) {
+        const int windowLength = (stft.windowLength > 0) ? stft.windowLength : framesPerBlock;
+        return (framesPerBlock > 0) && (stft.hopLength >= 0) && (windowLength % 2 == 0) && fft_size_supported(windowLength / 2);
+    }
+
+    /** Allocate everything for the block size and channel count \a queue was initialized with and \a historyRows
+        rows of history (which the renderer keeps; see AudioAnalysisSnapshot), then start the analysis thread draining \a queue. \a blockDuration is the length of a
+        block in seconds. \a stft sets the spectrum's window and hop, which default to one FFT per block, and
+        must pass supportsSTFT(); the raw history must be long enough to hold a window. \a slidingSpectrum
+        configures the sliding spectrum, \a filterbank the perceptual bands and \a constantQ the
+        constant-Q transform and \a onsets the onset detector, all of which are off by default; the raw
+        history must hold a whole constant-Q window too.
+
+        May be called again (e.g. with a new block size) once the producer has stopped. Every snapshot,
+        including the one the render thread holds, is reset to an empty one of the new size. */
+    void start(AudioBlockQueue* queue, int historyRows, RealTime blockDuration, const STFTSettings& stft = STFTSettings(),
+               const SlidingSpectrumSettings& slidingSpectrum = SlidingSpectrumSettings(),
+               const FilterbankSettings& filterbank = FilterbankSettings(),
+               const ConstantQSettings& constantQ = ConstantQSettings(), const OnsetDetector::Settings& onsets = OnsetDetector::Settings());
+
+    /** Stop and join the analysis thread. Safe to call when it isn't running. */
+    void stop();
+
+    /** Window the spectrum with one of the FFT_WINDOW_* windows (Hann by default), starting with the next block.
+        May be called from any thread at any time; the window tables come with the FFT plan, so switching is free. */
+    void setWindow(int window) {
+        m_fftWindow = window;
+    }
+
+    int window() const {
+        return m_fftWindow;
+    }
+
+    /** Rows of history the renderer should keep, as passed to start() */
+    int historyRows() const {
+        return m_historyRows;
+    }
+
+    /** The constant-Q transform's bins. Fixed between calls to start(), so any thread may read them */
+    const ConstantQ& constantQ() const {
+        return m_constantQ;
+    }
+
+    /** Render thread only. Take the oldest onset not taken yet; returns false if there is none. Onsets are found
+        one STFT hop after the frame they belong to (see OnsetDetector) */
+    bool popOnsetEvent(OnsetEvent& event) {
+        return m_onsetEvents.pop(event);
+    }
+
+    /** Onsets lost because the render thread didn't take them in time */
+    uint64 droppedOnsetEventCount() const {
+        return m_onsetEvents.droppedCount();
+    }
+
+    /** Render thread only. Pick up the most recently published snapshot; returns true if it is new */
+    bool updateSnapshot() {
+        return m_snapshots.update();
+    }
+
+    /** Render thread only. The snapshot taken by the last updateSnapshot() */
+    const AudioAnalysisSnapshot& snapshot() const {
+        return m_snapshots.front();
+    }
+};
+
+#endif
@@ -0,0 +1,200 @@
+/**
+  \file AudioBlockQueue.h
+
+  Lock-free single-producer/single-consumer ring buffer of fixed-size audio blocks,
+  used to hand captured audio from the RtAudio callback thread to the analysis side.
+ */
+#ifndef AudioBlockQueue_h
+#define AudioBlockQueue_h
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+/** Seconds on the monotonic clock every AudioBlockInfo::captureTime is measured with. Only differences are
+    meaningful; compare against it (not G3D's clocks) to measure how old a block is. */
+inline double audioCaptureClock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Bookkeeping that travels through the queue alongside each block's samples */
+struct AudioBlockInfo {
+    /** Assigned by the producer to every block it is handed, including blocks it has to drop,
+        so a gap between consecutive sequence numbers seen by the consumer means lost audio */
+    uint64_t sequence;
+
+    /** Position of the block's first frame on the audio clock, in seconds since the stream started
+        (RtAudio's streamTime, or frames produced / sample rate for an AudioSource) */
+    double   streamTime;
+
+    /** audioCaptureClock() when the producer pushed the block */
+    double   captureTime;
+
+    /** RtAudioStreamStatus flags the callback was handed with the block; 0 for AudioSources */
+    uint32_t status;
+
+    AudioBlockInfo() : sequence(0), streamTime(0.0), captureTime(0.0), status(0) {}
+};
+
+/**
+  A ring buffer of blocks of float samples, sized in blocks. Each block holds framesPerBlock() frames of
+  channelCount() interleaved samples, the layout RtAudio hands its callback.
+
+  Exactly one thread may push (the audio callback) and exactly one thread may pop (the analysis side).
+  All storage is allocated by init(), so push() and the pop functions never allocate or lock, and are
+  safe to call from the realtime audio thread.
+
+  A block only becomes visible to the consumer after every sample of it has been written, and the producer
+  never writes into a block the consumer has not released yet, so reads are never torn. When the queue is
+  full the producer drops the incoming block (and counts it) instead of overwriting unread data.
+ */
+class AudioBlockQueue {
+protected:
+    /** Keep the producer and consumer indices on separate cache lines so they don't false-share */
+    struct alignas(64) PaddedIndex {
+        std::atomic<uint64_t> value;
+        PaddedIndex() : value(0) {}
+    };
+
+    /** m_blockCapacity * m_samplesPerBlock samples */
+    std::vector<float>      m_samples;
+    /** One entry per block slot */
+    std::vector<AudioBlockInfo> m_infos;
+    int                     m_framesPerBlock;
+    int                     m_channelCount;
+    /** m_framesPerBlock * m_channelCount */
+    int                     m_samplesPerBlock;
+    int                     m_blockCapacity;
+
+    /** Total number of blocks ever pushed. Only written by the producer */
+    PaddedIndex             m_writeIndex;
+    /** Total number of blocks ever popped. Only written by the consumer */
+    PaddedIndex             m_readIndex;
+    /** Number of blocks the producer threw away because the consumer fell behind */
+    PaddedIndex             m_droppedBlockCount;
+
+    /** Sequence number for the next block handed to push(). Only touched by the producer */
+    uint64_t                m_nextSequence;
+
+    size_t slotIndex(uint64_t index) const {
+        return (size_t)(index % (uint64_t)m_blockCapacity);
+    }
+
+    float* slot(uint64_t index) {
+        return m_samples.data() + slotIndex(index) * m_samplesPerBlock;
+    }
+
+public:
+
+    AudioBlockQueue() : m_framesPerBlock(0), m_channelCount(0), m_samplesPerBlock(0), m_blockCapacity(0), m_nextSequence(0) {}
+
+    /** Allocate storage for \a blockCapacity blocks of \a framesPerBlock frames of \a channelCount samples each
+        and empty the queue. Not thread safe: only call while neither the producer nor the consumer is running. */
+    void init(int framesPerBlock, int channelCount, int blockCapacity) {
+        m_framesPerBlock  = framesPerBlock;
+        m_channelCount    = channelCount;
+        m_samplesPerBlock = framesPerBlock * channelCount;
+        m_blockCapacity   = blockCapacity;
+        m_samples.assign((size_t)m_samplesPerBlock * blockCapacity, 0.0f);
+        m_infos.assign(blockCapacity, AudioBlockInfo());
+        m_nextSequence = 0;
+        m_writeIndex.value.store(0);
+        m_readIndex.value.store(0);
+        m_droppedBlockCount.value.store(0);
+    }
+
+    int framesPerBlock() const {
+        return m_framesPerBlock;
+    }
+
+    int channelCount() const {
+        return m_channelCount;
+    }
+
+    /** framesPerBlock() * channelCount() */
+    int samplesPerBlock() const {
+        return m_samplesPerBlock;
+    }
+
+    int blockCapacity() const {
+        return m_blockCapacity;
+    }
+
+    /** Producer only. Copy \a sampleCount interleaved samples in as a new block, zero-padding short blocks, and tag it
+        with the next sequence number and the given timestamps (see AudioBlockInfo).
+        Returns false (and drops the block) if the queue is full. */
+    bool push(const float* samples, int sampleCount, double streamTime, double captureTime, uint32_t status = 0) {
+        const uint64_t sequence = m_nextSequence++;
+        const uint64_t w = m_writeIndex.value.load(std::memory_order_relaxed);
+        const uint64_t r = m_readIndex.value.load(std::memory_order_acquire);
+        if (w - r >= (uint64_t)m_blockCapacity) {
+            m_droppedBlockCount.value.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        float* dst = slot(w);
+        const int n = (sampleCount < m_samplesPerBlock) ? sampleCount : m_samplesPerBlock;
+        memcpy(dst, samples, sizeof(float) * n);
+        if (n < m_samplesPerBlock) {
+            memset(dst + n, 0, sizeof(float) * (m_samplesPerBlock - n));
+        }
+        AudioBlockInfo& info = m_infos[slotIndex(w)];
+        info.sequence    = sequence;
+        info.streamTime  = streamTime;
+        info.captureTime = captureTime;
+        info.status      = status;
+        // Publish the block only after all of its samples are written
+        m_writeIndex.value.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Producer only. True if push() would drop a block right now */
+    bool full() const {
+        const uint64_t w = m_writeIndex.value.load(std::memory_order_relaxed);
+        const uint64_t r = m_readIndex.value.load(std::memory_order_acquire);
+        return w - r >= (uint64_t)m_blockCapacity;
+    }
+
+    /** Consumer only. Number of complete blocks waiting to be read */
+    int size() const {
+        const uint64_t w = m_writeIndex.value.load(std::memory_order_acquire);
+        const uint64_t r = m_readIndex.value.load(std::memory_order_relaxed);
+        return (int)(w - r);
+    }
+
+    /** Consumer only. Pointer to the oldest unread block, or nullptr if the queue is empty.
+        The block stays valid (and untouched by the producer) until pop() is called. */
+    const float* front() {
+        return (size() > 0) ? slot(m_readIndex.value.load(std::memory_order_relaxed)) : nullptr;
+    }
+
+    /** Consumer only. Bookkeeping for the block returned by front(). Only valid while the queue is non-empty */
+    const AudioBlockInfo& frontInfo() const {
+        return m_infos[slotIndex(m_readIndex.value.load(std::memory_order_relaxed))];
+    }
+
+    /** Consumer only. Release the block returned by front() back to the producer */
+    void pop() {
+        const uint64_t r = m_readIndex.value.load(std::memory_order_relaxed);
+        m_readIndex.value.store(r + 1, std::memory_order_release);
+    }
+
+    /** Consumer only. Copy the oldest unread block into \a dst and release it. Returns false if empty. */
+    bool pop(float* dst) {
+        const float* src = front();
+        if (src == nullptr) {
+            return false;
+        }
+        memcpy(dst, src, sizeof(float) * m_samplesPerBlock);
+        pop();
+        return true;
+    }
+
+    /** Number of blocks dropped so far because the queue was full. Safe to call from any thread. */
+    uint64_t droppedBlockCount() const {
+        return m_droppedBlockCount.value.load(std::memory_order_relaxed);
+    }
+};
+
+#endif
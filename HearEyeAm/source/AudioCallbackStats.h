@@ -0,0 +1,171 @@
+/**
+  \file AudioCallbackStats.h
+
+  Lock-free health counters for the audio callback: overflows/underflows, how long the callback takes,
+  and how regularly it is called.
+ */
+#ifndef AudioCallbackStats_h
+#define AudioCallbackStats_h
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+/** Plain copy of an AudioCallbackStats, for displaying and logging. Times are in seconds */
+struct AudioCallbackStatistics {
+    uint64_t    callbackCount;
+    /** Callbacks that were flagged RTAUDIO_INPUT_OVERFLOW: the driver lost input before we got to it */
+    uint64_t    inputOverflowCount;
+    /** Callbacks that were flagged RTAUDIO_OUTPUT_UNDERFLOW (duplex streams only) */
+    uint64_t    outputUnderflowCount;
+
+    /** Time spent inside the callback. The average is over every callback; min and max only over the current window */
+    double      averageDuration;
+    double      minDuration;
+    double      maxDuration;
+
+    /** Block duration, which is how far apart callbacks should be */
+    double      expectedInterval;
+    /** |actual - expected| time between the starts of consecutive callbacks. Average over every callback,
+        max over the current window */
+    double      averageJitter;
+    double      maxJitter;
+
+    AudioCallbackStatistics() : callbackCount(0), inputOverflowCount(0), outputUnderflowCount(0), averageDuration(0.0),
+        minDuration(0.0), maxDuration(0.0), expectedInterval(0.0), averageJitter(0.0), maxJitter(0.0) {}
+};
+
+/**
+  Statistics gathered by the audio callback about itself.
+
+  Exactly one thread (the audio callback) may call recordCallback(); any thread may call read() and
+  resetWindow(). Nothing here locks or allocates, so recordCallback() is safe on the realtime thread.
+  Counters and totals accumulate from reset(); the min/max values cover a "window" that starts over
+  whenever a reader calls resetWindow(), so they can be logged per period.
+ */
+class AudioCallbackStats {
+protected:
+    typedef std::atomic<uint64_t> Counter;
+
+    static const uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+    Counter             m_callbackCount;
+    Counter             m_inputOverflowCount;
+    Counter             m_outputUnderflowCount;
+
+    /** All durations are stored in nanoseconds so they fit in lock-free integers */
+    Counter             m_totalDuration;
+    Counter             m_minDuration;
+    Counter             m_maxDuration;
+
+    /** Intervals measured so far (one fewer than callbacks) and their total jitter */
+    Counter             m_intervalCount;
+    Counter             m_totalJitter;
+    Counter             m_maxJitter;
+
+    uint64_t            m_expectedInterval;
+
+    /** Set by resetWindow(), cleared by the callback when it starts the new window */
+    std::atomic<bool>   m_windowResetRequested;
+
+    /** Start of the previous callback. Only touched by the callback */
+    double              m_previousStartTime;
+
+    static uint64_t toNanoseconds(double seconds) {
+        return (seconds > 0.0) ? (uint64_t)(seconds * 1e9 + 0.5) : 0;
+    }
+
+    static double toSeconds(uint64_t nanoseconds) {
+        return nanoseconds * 1e-9;
+    }
+
+public:
+
+    AudioCallbackStats() {
+        reset(0.0);
+    }
+
+    /** Zero everything, for a stream whose blocks last \a expectedInterval seconds.
+        Not thread safe: only call while the callback isn't running. */
+    void reset(double expectedInterval) {
+        m_callbackCount.store(0);
+        m_inputOverflowCount.store(0);
+        m_outputUnderflowCount.store(0);
+        m_totalDuration.store(0);
+        m_minDuration.store(NONE);
+        m_maxDuration.store(0);
+        m_intervalCount.store(0);
+        m_totalJitter.store(0);
+        m_maxJitter.store(0);
+        m_expectedInterval = toNanoseconds(expectedInterval);
+        m_windowResetRequested.store(false);
+        m_previousStartTime = -1.0;
+    }
+
+    /** Callback only. Record one callback that ran from \a startTime to \a endTime (seconds, on any monotonic clock) */
+    void recordCallback(double startTime, double endTime, bool inputOverflow, bool outputUnderflow) {
+        if (m_windowResetRequested.exchange(false, std::memory_order_relaxed)) {
+            m_minDuration.store(NONE, std::memory_order_relaxed);
+            m_maxDuration.store(0, std::memory_order_relaxed);
+            m_maxJitter.store(0, std::memory_order_relaxed);
+        }
+
+        // We are the only writer, so plain load/store pairs are enough; readers just never see a torn value
+        const uint64_t duration = toNanoseconds(endTime - startTime);
+        m_totalDuration.store(m_totalDuration.load(std::memory_order_relaxed) + duration, std::memory_order_relaxed);
+        if (duration < m_minDuration.load(std::memory_order_relaxed)) {
+            m_minDuration.store(duration, std::memory_order_relaxed);
+        }
+        if (duration > m_maxDuration.load(std::memory_order_relaxed)) {
+            m_maxDuration.store(duration, std::memory_order_relaxed);
+        }
+
+        if (m_previousStartTime >= 0.0) {
+            const uint64_t interval = toNanoseconds(startTime - m_previousStartTime);
+            const uint64_t jitter = (interval > m_expectedInterval) ? interval - m_expectedInterval : m_expectedInterval - interval;
+            m_totalJitter.store(m_totalJitter.load(std::memory_order_relaxed) + jitter, std::memory_order_relaxed);
+            if (jitter > m_maxJitter.load(std::memory_order_relaxed)) {
+                m_maxJitter.store(jitter, std::memory_order_relaxed);
+            }
+            m_intervalCount.store(m_intervalCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        m_previousStartTime = startTime;
+
+        if (inputOverflow) {
+            m_inputOverflowCount.store(m_inputOverflowCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        if (outputUnderflow) {
+            m_outputUnderflowCount.store(m_outputUnderflowCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        m_callbackCount.store(m_callbackCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** Any thread. The values are read one at a time, so they may be a callback apart from each other */
+    AudioCallbackStatistics read() const {
+        AudioCallbackStatistics s;
+        s.callbackCount         = m_callbackCount.load(std::memory_order_acquire);
+        s.inputOverflowCount    = m_inputOverflowCount.load(std::memory_order_relaxed);
+        s.outputUnderflowCount  = m_outputUnderflowCount.load(std::memory_order_relaxed);
+        s.expectedInterval      = toSeconds(m_expectedInterval);
+        if (s.callbackCount > 0) {
+            s.averageDuration = toSeconds(m_totalDuration.load(std::memory_order_relaxed)) / s.callbackCount;
+        }
+        const uint64_t minDuration = m_minDuration.load(std::memory_order_relaxed);
+        s.minDuration = (minDuration == NONE) ? 0.0 : toSeconds(minDuration);
+        s.maxDuration = toSeconds(m_maxDuration.load(std::memory_order_relaxed));
+
+        const uint64_t intervalCount = m_intervalCount.load(std::memory_order_relaxed);
+        if (intervalCount > 0) {
+            s.averageJitter = toSeconds(m_totalJitter.load(std::memory_order_relaxed)) / intervalCount;
+        }
+        s.maxJitter = toSeconds(m_maxJitter.load(std::memory_order_relaxed));
+        return s;
+    }
+
+    /** Any thread. Start a new min/max window at the next callback */
+    void resetWindow() {
+        m_windowResetRequested.store(true, std::memory_order_relaxed);
+    }
+};
+
+#endif
@@ -0,0 +1,133 @@
+/**
+  \file AudioHistory.h
+
+  Fixed-size rolling history of rows (e.g. one row of samples or spectrum per audio block).
+ */
+#ifndef AudioHistory_h
+#define AudioHistory_h
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+/**
+  Ring buffer of the last rowCapacity() rows of rowSize() elements each, oldest first.
+
+  Every row is stored twice, rowCapacity() rows apart, so the whole history is always available as one
+  contiguous, correctly ordered block through rows(); nothing ever has to be shifted down when a row is
+  appended, and the history can be uploaded to a texture straight from rows(). Before rowCapacity() rows
+  have been appended, the oldest rows are zero.
+
+  T must be a POD type.
+ */
+template<class T>
+class AudioHistory {
+protected:
+    /** 2 * m_rowCapacity rows */
+    std::vector<T>  m_data;
+    int             m_rowSize;
+    int             m_rowCapacity;
+    /** Total number of rows ever appended */
+    uint64_t        m_rowCount;
+
+    T* storedRow(uint64_t row) {
+        return m_data.data() + (size_t)(row % (uint64_t)m_rowCapacity) * m_rowSize;
+    }
+
+    const T* storedRow(uint64_t row) const {
+        return m_data.data() + (size_t)(row % (uint64_t)m_rowCapacity) * m_rowSize;
+    }
+
+    T* mirroredRow(uint64_t row) {
+        return storedRow(row) + (size_t)m_rowCapacity * m_rowSize;
+    }
+
+public:
+
+    AudioHistory() : m_rowSize(0), m_rowCapacity(0), m_rowCount(0) {}
+
+    /** Allocate (zeroed) storage and forget all rows */
+    void init(int rowSize, int rowCapacity) {
+        m_rowSize = rowSize;
+        m_rowCapacity = rowCapacity;
+        m_rowCount = 0;
+        m_data.assign((size_t)2 * rowSize * rowCapacity, T());
+    }
+
+    int rowSize() const {
+        return m_rowSize;
+    }
+
+    int rowCapacity() const {
+        return m_rowCapacity;
+    }
+
+    /** Total number of rows ever appended; the newest row has index rowCount() - 1 */
+    uint64_t rowCount() const {
+        return m_rowCount;
+    }
+
+    /** Storage to write the next row into, or the row \a offset rows after it (less than rowCapacity()), so
+        several rows can be written at once, e.g. on different threads. Rows become part of the history on
+        endRow() or endRows(), in order */
+    T* beginRow(int offset = 0) {
+        return storedRow(m_rowCount + offset);
+    }
+
+    /** Commit the row written through beginRow() */
+    void endRow() {
+        memcpy(mirroredRow(m_rowCount), storedRow(m_rowCount), sizeof(T) * m_rowSize);
+        ++m_rowCount;
+    }
+
+    /** Commit the next \a count rows written through beginRow() */
+    void endRows(int count) {
+        for (int i = 0; i < count; ++i) {
+            endRow();
+        }
+    }
+
+    void appendRow(const T* src) {
+        memcpy(beginRow(), src, sizeof(T) * m_rowSize);
+        endRow();
+    }
+
+    /** Row \a row (counted from the first row ever appended). Only the last rowCapacity() rows are available */
+    const T* row(uint64_t row) const {
+        return storedRow(row);
+    }
+
+    /** Element \a element of the history, counting every element of every row ever appended, in order. It is
+        followed contiguously by every later element up to the end of the newest row, so any run of samples
+        that spans rows (e.g. an analysis window) can be read in place. Only the last rowCapacity() rows are
+        available */
+    const T* element(uint64_t element) const {
+        return storedRow(element / (uint64_t)m_rowSize) + (size_t)(element % (uint64_t)m_rowSize);
+    }
+
+    /** The newest row */
+    const T* newestRow() const {
+        return storedRow(m_rowCount + m_rowCapacity - 1);
+    }
+
+    /** All rowCapacity() rows, oldest first, contiguous */
+    const T* rows() const {
+        return storedRow(m_rowCount);
+    }
+
+    /** Bring this history up to date with \a src (which must have the same row size and at least as many rows)
+        by copying only the rows appended to \a src since the last sync, or just the last rowCapacity() of them */
+    void syncFrom(const AudioHistory<T>& src) {
+        uint64_t first = m_rowCount;
+        if (src.m_rowCount - first > (uint64_t)m_rowCapacity) {
+            first = src.m_rowCount - m_rowCapacity;
+        }
+        for (uint64_t r = first; r < src.m_rowCount; ++r) {
+            memcpy(storedRow(r), src.storedRow(r), sizeof(T) * m_rowSize);
+            memcpy(mirroredRow(r), src.storedRow(r), sizeof(T) * m_rowSize);
+        }
+        m_rowCount = src.m_rowCount;
+    }
+};
+
+#endif
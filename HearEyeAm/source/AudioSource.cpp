@@ -0,0 +1,69 @@
+/** \file AudioSource.cpp */
+#include "AudioSource.h"
+#include <chrono>
+
+AudioSource::AudioSource() :
+    m_queue(nullptr),
+    m_framesPerBlock(0),
+    m_channelsPerFrame(0),
+    m_samplesPerBlock(0),
+    m_pacing(Pacing::REAL_TIME),
+    m_running(false),
+    m_finished(false),
+    m_framesProduced(0) {}
+
+
+AudioSource::~AudioSource() {
+    stop();
+}
+
+
+void AudioSource::start(AudioBlockQueue* queue, Pacing pacing) {
+    stop();
+    m_queue = queue;
+    m_framesPerBlock = queue->framesPerBlock();
+    m_channelsPerFrame = queue->channelCount();
+    m_samplesPerBlock = queue->samplesPerBlock();
+    m_pacing = pacing;
+    m_block.resize(m_samplesPerBlock);
+    m_framesProduced = 0;
+    m_finished = false;
+    m_running = true;
+    m_thread = std::thread(&AudioSource::threadMain, this);
+}
+
+
+void AudioSource::stop() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+
+void AudioSource::threadMain() {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration blockDuration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(m_framesPerBlock / (double)sampleRate()));
+    // Much shorter than it takes the analyzer to drain a full queue, so it never sits idle waiting for us
+    const Clock::duration backoff = std::chrono::microseconds(100);
+
+    Clock::time_point nextBlockTime = Clock::now();
+    while (m_running) {
+        if (m_pacing == Pacing::REAL_TIME) {
+            // Schedule against absolute times so sleep jitter doesn't accumulate into drift
+            std::this_thread::sleep_until(nextBlockTime);
+            nextBlockTime += blockDuration;
+        } else if (m_queue->full()) {
+            std::this_thread::sleep_for(backoff);
+            continue;
+        }
+
+        if (!readBlock(m_block.getCArray())) {
+            m_finished = true;
+            break;
+        }
+        m_queue->push(m_block.getCArray(), m_samplesPerBlock, m_framesProduced / (double)sampleRate(), audioCaptureClock());
+        m_framesProduced += m_framesPerBlock;
+    }
+}
@@ -0,0 +1,76 @@
+/**
+  \file AudioSource.h
+
+  Audio sources that run on their own clock instead of a sound card's, feeding the same AudioBlockQueue
+  the RtAudio callback does.
+ */
+#ifndef AudioSource_h
+#define AudioSource_h
+
+#include <G3D/G3DAll.h>
+#include <atomic>
+#include <thread>
+#include "AudioBlockQueue.h"
+
+/**
+  Base class for a source that produces blocks on a thread of its own and pushes them into an AudioBlockQueue,
+  standing in for the RtAudio callback as the queue's single producer.
+
+  Subclasses only implement readBlock() (and sampleRate()); AudioSource handles the thread and the pacing.
+ */
+class AudioSource {
+public:
+    /** REAL_TIME pushes one block per block duration, like a sound card would. AS_FAST_AS_POSSIBLE pushes
+        blocks as soon as there is room in the queue, and waits (rather than dropping blocks) when it is full. */
+    G3D_DECLARE_ENUM_CLASS(Pacing,
+        REAL_TIME,
+        AS_FAST_AS_POSSIBLE);
+
+protected:
+    AudioBlockQueue*        m_queue;
+    int                     m_framesPerBlock;
+    /** Interleaved channels per frame, as the queue expects them */
+    int                     m_channelsPerFrame;
+    /** m_framesPerBlock * m_channelsPerFrame */
+    int                     m_samplesPerBlock;
+    Pacing                  m_pacing;
+
+    std::thread             m_thread;
+    std::atomic<bool>       m_running;
+    std::atomic<bool>       m_finished;
+
+    /** Frames produced since start(), which is the source's stream clock */
+    uint64                  m_framesProduced;
+
+    /** Allocated in start(), so the pump loop never allocates */
+    Array<float>            m_block;
+
+    AudioSource();
+
+    void threadMain();
+
+    /** Fill \a block with the next m_framesPerBlock frames of m_channelsPerFrame interleaved samples. Called on the source's thread.
+        Returns false once the source is exhausted (\a block is then ignored). */
+    virtual bool readBlock(float* block) = 0;
+
+public:
+
+    /** Subclasses must call stop() in their own destructor, since the thread calls readBlock() */
+    virtual ~AudioSource();
+
+    virtual int sampleRate() const = 0;
+
+    /** Start pushing blocks into \a queue, which must already be initialized; the source produces whatever
+        block size and channel count the queue was initialized with */
+    void start(AudioBlockQueue* queue, Pacing pacing);
+
+    /** Stop and join the source's thread. Safe to call when it isn't running. */
+    void stop();
+
+    /** True once readBlock() has reported the end of the source */
+    bool finished() const {
+        return m_finished;
+    }
+};
+
+#endif
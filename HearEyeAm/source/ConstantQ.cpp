@@ -0,0 +1,127 @@
+/** \file ConstantQ.cpp */
+#include "ConstantQ.h"
+#include <algorithm>
+#include <cmath>
+
+static double qualityFactor(int binsPerOctave) {
+    return 1.0 / (std::pow(2.0, 1.0 / binsPerOctave) - 1.0);
+}
+
+
+ConstantQ::ConstantQ() :
+    m_plan(nullptr),
+    m_fftLength(0),
+    m_binsPerOctave(0),
+    m_minFrequency(0.0) {}
+
+
+ConstantQ::~ConstantQ() {
+    fft_plan_destroy(m_plan);
+}
+
+
+int ConstantQ::fftLengthFor(double sampleRate, double minFrequency, int binsPerOctave) {
+    const double longestKernel = std::ceil(qualityFactor(binsPerOctave) * sampleRate / minFrequency);
+    int length = 16;
+    while (length < longestKernel) {
+        length *= 2;
+    }
+    return length;
+}
+
+
+void ConstantQ::init(double sampleRate, double minFrequency, double maxFrequency, int binsPerOctave, double threshold) {
+    fft_plan_destroy(m_plan);
+    m_plan = nullptr;
+    m_fftLength = 0;
+    m_binsPerOctave = binsPerOctave;
+    m_minFrequency = minFrequency;
+    m_frequency.clear();
+    m_kernelOffset.assign(1, 0);
+    m_kernelBin.clear();
+    m_kernel.clear();
+    if ((binsPerOctave <= 0) || (minFrequency <= 0.0)) {
+        return;
+    }
+
+    // Keep the top bin's main lobe (two bins either side of its center) below Nyquist
+    maxFrequency = std::min(maxFrequency, 0.5 * sampleRate * std::pow(2.0, -2.0 / binsPerOctave));
+    if (maxFrequency < minFrequency) {
+        return;
+    }
+    const int binCount = (int)std::floor(binsPerOctave * std::log2(maxFrequency / minFrequency) + 1e-9) + 1;
+    m_frequency.resize(binCount);
+    for (int k = 0; k < binCount; ++k) {
+        m_frequency[k] = minFrequency * std::pow(2.0, k / (double)binsPerOctave);
+    }
+
+    m_fftLength = fftLengthFor(sampleRate, minFrequency, binsPerOctave);
+    m_plan = fft_plan_create(m_fftLength / 2);
+    m_spectrum.resize(m_fftLength);
+    m_work.resize(m_fftLength);
+
+    // Brown & Puckette: with X = rfft(x) and A = rfft(a) (both 1/N scaled), sum_n x[n] conj(a[n]) is
+    // N * sum_j X[j] conj(A[j]). The kernels are complex, so transform their real and imaginary parts
+    // separately and combine. Each kernel turns clockwise so that, with rfft()'s exp(+i) convention, its energy
+    // lands on the positive-frequency half rfft() keeps; the other half is negligible and left out
+    const double q = qualityFactor(binsPerOctave);
+    const double pi = 3.14159265358979323846;
+    std::vector<float> re(m_fftLength);
+    std::vector<float> im(m_fftLength);
+    std::vector<float> window;
+    std::vector<complex> spectrum(m_fftLength / 2);
+    for (int k = 0; k < binCount; ++k) {
+        const int kernelLength = std::min(m_fftLength, (int)std::ceil(q * sampleRate / m_frequency[k]));
+        window.resize(kernelLength);
+        fft_window_fill(window.data(), kernelLength, FFT_WINDOW_HANNING);
+
+        // Right-aligned, so the kernel ends at the newest sample
+        std::fill(re.begin(), re.end(), 0.0f);
+        std::fill(im.begin(), im.end(), 0.0f);
+        const int start = m_fftLength - kernelLength;
+        for (int n = 0; n < kernelLength; ++n) {
+            const double phase = -2.0 * pi * m_frequency[k] * n / sampleRate;
+            re[start + n] = (float)(window[n] * std::cos(phase) / kernelLength);
+            im[start + n] = (float)(window[n] * std::sin(phase) / kernelLength);
+        }
+        rfft_with_plan(m_plan, re.data(), FFT_FORWARD);
+        rfft_with_plan(m_plan, im.data(), FFT_FORWARD);
+
+        // Bin 0 holds DC and Nyquist packed together, and the kernel has neither
+        float peak = 0.0f;
+        for (int j = 1; j < m_fftLength / 2; ++j) {
+            spectrum[j].re = re[2 * j] - im[2 * j + 1];
+            spectrum[j].im = re[2 * j + 1] + im[2 * j];
+            peak = std::max(peak, (float)cmp_abs(spectrum[j]));
+        }
+        const float cutoff = (float)(threshold * peak);
+        for (int j = 1; j < m_fftLength / 2; ++j) {
+            if (cmp_abs(spectrum[j]) >= cutoff) {
+                complex weight;
+                weight.re = m_fftLength * spectrum[j].re;
+                weight.im = -m_fftLength * spectrum[j].im;
+                m_kernelBin.push_back(j);
+                m_kernel.push_back(weight);
+            }
+        }
+        m_kernelOffset.push_back((int)m_kernel.size());
+    }
+}
+
+
+void ConstantQ::transform(const float* samples, complex* out) {
+    rfft_stockham(m_plan, samples, m_spectrum.data(), m_work.data(), FFT_FORWARD);
+    const complex* spectrum = (const complex*)m_spectrum.data();
+    for (int k = 0; k < binCount(); ++k) {
+        float re = 0.0f;
+        float im = 0.0f;
+        for (int i = m_kernelOffset[k]; i < m_kernelOffset[k + 1]; ++i) {
+            const complex x = spectrum[m_kernelBin[i]];
+            const complex w = m_kernel[i];
+            re += x.re * w.re - x.im * w.im;
+            im += x.re * w.im + x.im * w.re;
+        }
+        out[k].re = re;
+        out[k].im = im;
+    }
+}
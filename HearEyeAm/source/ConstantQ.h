@@ -0,0 +1,95 @@
+/**
+  \file ConstantQ.h
+
+  Constant-Q transform (Brown & Puckette's sparse spectral kernel method) on top of chuck_fft's rfft. Like
+  FFTBatch, this only depends on the standard library and chuck_fft.
+ */
+#ifndef ConstantQ_h
+#define ConstantQ_h
+
+#include <vector>
+#include "chuck_fft.h"
+
+/**
+  Bins spaced binsPerOctave() to the octave from minFrequency() up, each with a Hann-windowed kernel
+  Q = 1 / (2^(1/binsPerOctave) - 1) cycles long, so every bin is as wide as the spacing to its neighbour:
+  bass bins get long windows and fine resolution, treble bins short windows and fast response.
+
+  Rather than correlating the samples with every kernel, each kernel is transformed once in init() and
+  everything below threshold x its peak is dropped, leaving a few nonzero FFT bins per kernel (more for the
+  short, treble ones). transform() is then one rfft of fftLength() samples plus one complex multiply-add per
+  kernel entry.
+
+  Every kernel ends at the newest sample, so treble bins only see the last few milliseconds rather than the
+  middle of the longest window. Results have rfft()'s sign convention and are scaled like a Hann-windowed
+  rfft() bin: a unit-amplitude sinusoid on a bin's frequency gives a magnitude of about 0.25.
+
+  Not thread safe: transform() uses scratch space kept in the object.
+ */
+class ConstantQ {
+protected:
+    fft_plan*                           m_plan;
+    int                                 m_fftLength;
+    int                                 m_binsPerOctave;
+    double                              m_minFrequency;
+
+    std::vector<double>                 m_frequency;
+
+    /** The sparse kernel: entries m_kernelOffset[k] up to m_kernelOffset[k + 1] belong to CQ bin k, and each
+        multiplies FFT bin m_kernelBin[i] by m_kernel[i] */
+    std::vector<int>                    m_kernelOffset;
+    std::vector<int>                    m_kernelBin;
+    std::vector<complex>                m_kernel;
+
+    /** fftLength() floats each */
+    std::vector<float>                  m_spectrum;
+    std::vector<float>                  m_work;
+
+public:
+
+    ConstantQ();
+    ~ConstantQ();
+
+    // Owns m_plan
+    ConstantQ(const ConstantQ&) = delete;
+    ConstantQ& operator=(const ConstantQ&) = delete;
+
+    /** Bins from \a minFrequency up to (at most) \a maxFrequency (Hz, clamped below Nyquist) at \a sampleRate,
+        \a binsPerOctave to the octave. Kernel entries below \a threshold x the kernel's peak are dropped. A
+        \a binsPerOctave of 0 turns the transform off. */
+    void init(double sampleRate, double minFrequency, double maxFrequency, int binsPerOctave, double threshold = 0.0054);
+
+    /** Samples transform() needs for these settings: the longest (lowest) kernel, rounded up to a power of 2 */
+    static int fftLengthFor(double sampleRate, double minFrequency, int binsPerOctave);
+
+    int binCount() const {
+        return (int)m_frequency.size();
+    }
+
+    int binsPerOctave() const {
+        return m_binsPerOctave;
+    }
+
+    double minFrequency() const {
+        return m_minFrequency;
+    }
+
+    /** Center frequency of bin \a k, in Hz */
+    double frequency(int k) const {
+        return m_frequency[k];
+    }
+
+    int fftLength() const {
+        return m_fftLength;
+    }
+
+    /** Nonzero entries of the sparse kernel, i.e. complex multiply-adds per transform() besides the FFT */
+    int kernelEntryCount() const {
+        return (int)m_kernel.size();
+    }
+
+    /** All binCount() bins of the fftLength() samples ending at samples[fftLength() - 1] */
+    void transform(const float* samples, complex* out);
+};
+
+#endif
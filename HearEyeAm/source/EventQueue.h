@@ -0,0 +1,88 @@
+/**
+  \file EventQueue.h
+
+  Lock-free single-producer/single-consumer queue of small events (e.g. onsets found by the analysis thread,
+  read by the render thread).
+ */
+#ifndef EventQueue_h
+#define EventQueue_h
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+/**
+  A ring buffer of up to capacity() events of type T (which must be copyable). Same rules as AudioBlockQueue:
+  exactly one thread pushes and exactly one pops, storage is only allocated by init(), an event only becomes
+  visible once it is completely written, and when the queue is full new events are dropped (and counted)
+  rather than overwriting ones the consumer hasn't read.
+ */
+template<class T>
+class EventQueue {
+protected:
+    /** Keep the producer and consumer indices on separate cache lines so they don't false-share */
+    struct alignas(64) PaddedIndex {
+        std::atomic<uint64_t> value;
+        PaddedIndex() : value(0) {}
+    };
+
+    std::vector<T>          m_events;
+
+    /** Total number of events ever pushed. Only written by the producer */
+    PaddedIndex             m_writeIndex;
+    /** Total number of events ever popped. Only written by the consumer */
+    PaddedIndex             m_readIndex;
+    /** Number of events the producer threw away because the consumer fell behind */
+    PaddedIndex             m_droppedCount;
+
+    size_t slotIndex(uint64_t index) const {
+        return (size_t)(index % (uint64_t)m_events.size());
+    }
+
+public:
+
+    /** Allocate room for \a capacity events and empty the queue. Not thread safe: only call while neither
+        the producer nor the consumer is running. */
+    void init(int capacity) {
+        m_events.assign(capacity, T());
+        m_writeIndex.value.store(0);
+        m_readIndex.value.store(0);
+        m_droppedCount.value.store(0);
+    }
+
+    int capacity() const {
+        return (int)m_events.size();
+    }
+
+    /** Producer only. Returns false (and drops \a event) if the queue is full */
+    bool push(const T& event) {
+        const uint64_t w = m_writeIndex.value.load(std::memory_order_relaxed);
+        const uint64_t r = m_readIndex.value.load(std::memory_order_acquire);
+        if (w - r >= (uint64_t)m_events.size()) {
+            m_droppedCount.value.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_events[slotIndex(w)] = event;
+        m_writeIndex.value.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Consumer only. Move the oldest unread event into \a event; returns false if there is none */
+    bool pop(T& event) {
+        const uint64_t r = m_readIndex.value.load(std::memory_order_relaxed);
+        const uint64_t w = m_writeIndex.value.load(std::memory_order_acquire);
+        if (r == w) {
+            return false;
+        }
+        event = m_events[slotIndex(r)];
+        m_readIndex.value.store(r + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Number of events dropped so far because the queue was full. Safe to call from any thread. */
+    uint64_t droppedCount() const {
+        return m_droppedCount.value.load(std::memory_order_relaxed);
+    }
+};
+
+#endif
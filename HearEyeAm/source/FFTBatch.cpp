@@ -0,0 +1,63 @@
+/** \file FFTBatch.cpp */
+#include "FFTBatch.h"
+#include <algorithm>
+#include <chrono>
+
+FFTBatch::FFTBatch(const fft_plan* plan, ThreadPool* pool) :
+    m_plan(plan),
+    m_pool(pool),
+    m_lastCount(0),
+    m_lastDuration(0.0) {}
+
+
+void FFTBatch::transform(bool real, const float* in, long inStride, const float* window, float* out, long outStride, long count, unsigned int forward) {
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    // One run of frames per thread
+    const long threadCount = m_pool ? m_pool->threadCount() : 1;
+    const long framesPerTask = (count + threadCount - 1) / threadCount;
+    const int taskCount = (framesPerTask > 0) ? (int)((count + framesPerTask - 1) / framesPerTask) : 0;
+
+    const long workSize = fft_batch_work_size(m_plan);
+    if ((long)m_work.size() < taskCount * workSize) {
+        m_work.resize(taskCount * workSize);
+    }
+
+    auto runTask = [&](int task) {
+        const long first = task * framesPerTask;
+        const long frameCount = std::min(framesPerTask, count - first);
+        float* work = m_work.data() + task * workSize;
+        if (real && forward) {
+            rfft_batch_windowed(m_plan, in + first * inStride, inStride, window, out + first * outStride, outStride, frameCount, work);
+        } else if (real) {
+            rfft_batch(m_plan, in + first * inStride, inStride, out + first * outStride, outStride, frameCount, work, forward);
+        } else {
+            cfft_batch(m_plan, in + first * inStride, inStride, out + first * outStride, outStride, frameCount, work, forward);
+        }
+    };
+    if (m_pool) {
+        m_pool->parallelFor(taskCount, runTask);
+    } else {
+        for (int task = 0; task < taskCount; ++task) {
+            runTask(task);
+        }
+    }
+
+    m_lastCount = count;
+    m_lastDuration = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+
+void FFTBatch::rfft(const float* in, long inStride, float* out, long outStride, long count, unsigned int forward) {
+    transform(true, in, inStride, nullptr, out, outStride, count, forward);
+}
+
+
+void FFTBatch::rfftWindowed(const float* in, long inStride, const float* window, float* out, long outStride, long count) {
+    transform(true, in, inStride, window, out, outStride, count, FFT_FORWARD);
+}
+
+
+void FFTBatch::cfft(const float* in, long inStride, float* out, long outStride, long count, unsigned int forward) {
+    transform(false, in, inStride, nullptr, out, outStride, count, forward);
+}
@@ -0,0 +1,58 @@
+/**
+  \file FFTBatch.h
+
+  Many same-size FFTs at once, split across the threads of a ThreadPool. Like ThreadPool, this only depends on
+  the standard library (and chuck_fft), so offline tools can use it without G3D.
+ */
+#ifndef FFTBatch_h
+#define FFTBatch_h
+
+#include <vector>
+#include "chuck_fft.h"
+#include "ThreadPool.h"
+
+/**
+  Runs rfft_batch()/cfft_batch() over a strided batch of frames, giving each thread of a ThreadPool (or just the
+  caller, without one) a contiguous run of them, which it transforms one frame at a time. Keeps one scratch
+  buffer per thread, so only the first call, or a call with more threads' worth of frames than before,
+  allocates. Every call is timed, for throughput.
+
+  Not thread safe: use from one thread at a time, like ThreadPool::parallelFor().
+ */
+class FFTBatch {
+protected:
+    const fft_plan*     m_plan;
+    ThreadPool*         m_pool;
+
+    /** fft_batch_work_size() floats per task */
+    std::vector<float>  m_work;
+
+    long                m_lastCount;
+    double              m_lastDuration;
+
+    /** \a window is only used for real forward transforms */
+    void transform(bool real, const float* in, long inStride, const float* window, float* out, long outStride, long count, unsigned int forward);
+
+public:
+
+    /** \a plan and \a pool must outlive this object; \a pool may be null to run everything on the caller */
+    explicit FFTBatch(const fft_plan* plan, ThreadPool* pool = nullptr);
+
+    /** rfft \a count frames of 2 * fft_plan_size() floats. Frame f is read from in + f * inStride and written to
+        out + f * outStride (strides in floats); \a in and \a out may be the same buffer with the same stride */
+    void rfft(const float* in, long inStride, float* out, long outStride, long count, unsigned int forward = FFT_FORWARD);
+
+    /** Forward rfft() of every frame multiplied by \a window (2 * fft_plan_size() floats, e.g. from fft_plan_window(),
+        or null for none). The window is applied as frames are read, as in rfft_stockham_windowed() */
+    void rfftWindowed(const float* in, long inStride, const float* window, float* out, long outStride, long count);
+
+    /** cfft version of rfft() */
+    void cfft(const float* in, long inStride, float* out, long outStride, long count, unsigned int forward = FFT_FORWARD);
+
+    /** Throughput of the last transform call, 0 before the first */
+    double transformsPerSecond() const {
+        return (m_lastDuration > 0.0) ? m_lastCount / m_lastDuration : 0.0;
+    }
+};
+
+#endif
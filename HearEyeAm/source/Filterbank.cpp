@@ -0,0 +1,98 @@
+/** \file Filterbank.cpp */
+#include "Filterbank.h"
+#include <algorithm>
+#include <cmath>
+
+Filterbank::Filterbank() :
+    m_binCount(0) {}
+
+
+double Filterbank::hzToMel(double hz) {
+    return 2595.0 * std::log10(1.0 + hz / 700.0);
+}
+
+
+double Filterbank::melToHz(double mel) {
+    return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0);
+}
+
+
+void Filterbank::init(int binCount, double binWidth, int bandCount, double minFrequency, double maxFrequency, Scale scale) {
+    m_binCount = binCount;
+    m_firstBin.clear();
+    m_weightOffset.clear();
+    m_weights.clear();
+    m_normalization.clear();
+    m_centerFrequency.clear();
+    if ((bandCount <= 0) || (binCount < 2)) {
+        return;
+    }
+
+    // Keep every triangle, including its outer half, on bins 1 .. binCount - 1
+    const double lowest = binWidth;
+    const double highest = (binCount - 1) * binWidth;
+    minFrequency = std::max(minFrequency, lowest);
+    maxFrequency = std::max(minFrequency, std::min(maxFrequency, highest));
+
+    // bandCount + 2 edges: band i rises from edge i to edge i + 1 and falls to edge i + 2
+    std::vector<double> edges(bandCount + 2);
+    for (int i = 0; i < bandCount + 2; ++i) {
+        const double alpha = i / (double)(bandCount + 1);
+        if (scale == MEL) {
+            const double minMel = hzToMel(minFrequency);
+            edges[i] = melToHz(minMel + alpha * (hzToMel(maxFrequency) - minMel));
+        } else {
+            edges[i] = minFrequency * std::pow(maxFrequency / minFrequency, alpha);
+        }
+    }
+
+    m_firstBin.resize(bandCount);
+    m_weightOffset.resize(bandCount + 1);
+    m_normalization.resize(bandCount);
+    m_centerFrequency.resize(bandCount);
+    for (int b = 0; b < bandCount; ++b) {
+        const double center = edges[b + 1];
+        const double lower = std::max(lowest, std::min(edges[b], center - binWidth));
+        const double upper = std::min(highest, std::max(edges[b + 2], center + binWidth));
+        const int first = std::max(1, (int)std::ceil(lower / binWidth));
+        const int last = std::min(binCount - 1, (int)std::floor(upper / binWidth));
+
+        m_firstBin[b] = first;
+        m_weightOffset[b] = (int)m_weights.size();
+        m_centerFrequency[b] = center;
+        double sum = 0.0;
+        for (int k = first; k <= last; ++k) {
+            const double frequency = k * binWidth;
+            double weight;
+            if (frequency <= center) {
+                weight = (center > lower) ? (frequency - lower) / (center - lower) : 1.0;
+            } else {
+                weight = (upper > center) ? (upper - frequency) / (upper - center) : 1.0;
+            }
+            weight = std::max(0.0, weight);
+            m_weights.push_back((float)weight);
+            sum += weight;
+        }
+        // Only possible when the whole range has collapsed onto one bin
+        if (sum <= 0.0) {
+            m_weights.push_back(1.0f);
+            sum = 1.0;
+        }
+        m_normalization[b] = (float)(1.0 / sum);
+    }
+    m_weightOffset[bandCount] = (int)m_weights.size();
+}
+
+
+void Filterbank::apply(const float* magnitudes, float* bands) const {
+    for (int b = 0; b < bandCount(); ++b) {
+        const float* bin = magnitudes + m_firstBin[b];
+        const float* weight = m_weights.data() + m_weightOffset[b];
+        const int count = m_weightOffset[b + 1] - m_weightOffset[b];
+        float sum = 0.0f;
+        for (int k = 0; k < count; ++k) {
+            sum += weight[k] * bin[k] * bin[k];
+        }
+        bands[b] = std::sqrt(sum * m_normalization[b]);
+    }
+}
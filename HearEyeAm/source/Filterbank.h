@@ -0,0 +1,69 @@
+/**
+  \file Filterbank.h
+
+  Sparse triangular filterbank (mel or log spaced) that folds a linear spectrum into a few perceptual bands.
+  Like ThreadPool and SlidingDFT, this only depends on the standard library.
+ */
+#ifndef Filterbank_h
+#define Filterbank_h
+
+#include <vector>
+
+/**
+  bandCount() overlapping triangles with centers spaced evenly on the mel (or log frequency) scale, each
+  running from its lower neighbour's center up to its own and back down to its upper neighbour's. Every
+  triangle spans at least a bin on each side, so bands narrower than a bin (at the low end of a long log
+  scale) interpolate between the two nearest bins instead of coming out empty.
+
+  Only the nonzero weights are kept: each band is a run of consecutive bins, so apply() costs about two
+  multiply-adds per bin no matter how many bands there are. A band's value is the RMS of its bins' magnitudes
+  under the triangle (sqrt of the weighted mean of |X|^2), which keeps it on the same scale as a single bin.
+ */
+class Filterbank {
+public:
+    enum Scale {
+        MEL,
+        LOG
+    };
+
+protected:
+    int                                 m_binCount;
+
+    /** For each band, its first bin and where its weights start in m_weights (plus one past the last band) */
+    std::vector<int>                    m_firstBin;
+    std::vector<int>                    m_weightOffset;
+    std::vector<float>                  m_weights;
+    /** 1 / sum of each band's weights */
+    std::vector<float>                  m_normalization;
+    std::vector<double>                 m_centerFrequency;
+
+public:
+
+    Filterbank();
+
+    /** \a bandCount bands between \a minFrequency and \a maxFrequency (Hz, clamped to the spectrum) over
+        spectra of \a binCount bins, \a binWidth Hz apart. Bin 0 is left out, since rfft() packs the Nyquist
+        value into it. A \a bandCount of 0 turns the filterbank off. */
+    void init(int binCount, double binWidth, int bandCount, double minFrequency, double maxFrequency, Scale scale = MEL);
+
+    int bandCount() const {
+        return (int)m_firstBin.size();
+    }
+
+    int binCount() const {
+        return m_binCount;
+    }
+
+    /** Peak of band \a i's triangle, in Hz */
+    double centerFrequency(int i) const {
+        return m_centerFrequency[i];
+    }
+
+    /** Fold binCount() bin magnitudes into bandCount() band values */
+    void apply(const float* magnitudes, float* bands) const;
+
+    static double hzToMel(double hz);
+    static double melToHz(double mel);
+};
+
+#endif
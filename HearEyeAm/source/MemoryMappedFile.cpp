@@ -0,0 +1,178 @@
+/** \file MemoryMappedFile.cpp */
+#include "MemoryMappedFile.h"
+
+#ifdef G3D_WINDOWS
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+static size_t systemPageSize() {
+#ifdef G3D_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+
+/** The whole pages [alignedOffset, alignedEnd) inside [offset, offset + length), clipped to the mapping (whose
+    end counts as a page boundary); alignedEnd <= alignedOffset if there are none */
+static void pagesWithin(size_t fileSize, size_t offset, size_t length, size_t& alignedOffset, size_t& alignedEnd) {
+    static const size_t pageSize = systemPageSize();
+    const size_t end = min(offset + length, fileSize);
+    alignedOffset = ((offset + pageSize - 1) / pageSize) * pageSize;
+    alignedEnd = (end == fileSize) ? end : end - (end % pageSize);
+}
+
+
+MemoryMappedFile::MemoryMappedFile() :
+    m_data(nullptr),
+    m_size(0),
+#ifdef G3D_WINDOWS
+    m_fileHandle(INVALID_HANDLE_VALUE),
+    m_mappingHandle(nullptr)
+#else
+    m_fileDescriptor(-1)
+#endif
+{}
+
+
+MemoryMappedFile::~MemoryMappedFile() {
+    close();
+}
+
+
+#ifdef G3D_WINDOWS
+
+bool MemoryMappedFile::open(const String& filename) {
+    close();
+    // Sequential scan makes the cache manager read ahead aggressively, which is all the prefetching we need
+    m_fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_fileHandle, &size) || (size.QuadPart == 0)) {
+        close();
+        return false;
+    }
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mappingHandle == nullptr) {
+        close();
+        return false;
+    }
+    m_data = (const uint8*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (m_data == nullptr) {
+        close();
+        return false;
+    }
+    m_size = (size_t)size.QuadPart;
+    return true;
+}
+
+
+void MemoryMappedFile::close() {
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mappingHandle != nullptr) {
+        CloseHandle(m_mappingHandle);
+        m_mappingHandle = nullptr;
+    }
+    if (m_fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_fileHandle);
+        m_fileHandle = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
+
+
+void MemoryMappedFile::prefetch(size_t offset, size_t length) const {
+    // Handled by FILE_FLAG_SEQUENTIAL_SCAN
+    (void)offset; (void)length;
+}
+
+
+size_t MemoryMappedFile::release(size_t offset, size_t length) const {
+    // Unlocking pages that aren't locked just removes them from our working set
+    if (m_data != nullptr && offset < m_size) {
+        size_t alignedOffset, alignedEnd;
+        pagesWithin(m_size, offset, length, alignedOffset, alignedEnd);
+        if (alignedEnd > alignedOffset) {
+            VirtualUnlock((LPVOID)(m_data + alignedOffset), alignedEnd - alignedOffset);
+            return alignedEnd;
+        }
+    }
+    return offset;
+}
+
+#else
+
+bool MemoryMappedFile::open(const String& filename) {
+    close();
+    m_fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+    if (m_fileDescriptor < 0) {
+        return false;
+    }
+    struct stat info;
+    if ((fstat(m_fileDescriptor, &info) != 0) || (info.st_size == 0)) {
+        close();
+        return false;
+    }
+    void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+    if (data == MAP_FAILED) {
+        close();
+        return false;
+    }
+    m_data = (const uint8*)data;
+    m_size = (size_t)info.st_size;
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    return true;
+}
+
+
+void MemoryMappedFile::close() {
+    if (m_data != nullptr) {
+        munmap((void*)m_data, m_size);
+        m_data = nullptr;
+    }
+    if (m_fileDescriptor >= 0) {
+        ::close(m_fileDescriptor);
+        m_fileDescriptor = -1;
+    }
+    m_size = 0;
+}
+
+
+void MemoryMappedFile::prefetch(size_t offset, size_t length) const {
+    // madvise needs a page-aligned start, and reading a little more ahead than asked is harmless
+    if (m_data != nullptr && offset < m_size) {
+        static const size_t pageSize = systemPageSize();
+        const size_t alignedOffset = offset - (offset % pageSize);
+        const size_t end = min(offset + length, m_size);
+        madvise((void*)(m_data + alignedOffset), end - alignedOffset, MADV_WILLNEED);
+    }
+}
+
+
+size_t MemoryMappedFile::release(size_t offset, size_t length) const {
+    // madvise rounds the length up to whole pages, so round the end down here or the page being read drops too
+    if (m_data != nullptr && offset < m_size) {
+        size_t alignedOffset, alignedEnd;
+        pagesWithin(m_size, offset, length, alignedOffset, alignedEnd);
+        if (alignedEnd > alignedOffset) {
+            madvise((void*)(m_data + alignedOffset), alignedEnd - alignedOffset, MADV_DONTNEED);
+            return alignedEnd;
+        }
+    }
+    return offset;
+}
+
+#endif
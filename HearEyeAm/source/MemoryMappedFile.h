@@ -0,0 +1,60 @@
+/**
+  \file MemoryMappedFile.h
+
+  Read-only memory mapping of a whole file, for streaming files far larger than we would want to load.
+ */
+#ifndef MemoryMappedFile_h
+#define MemoryMappedFile_h
+
+#include <G3D/G3DAll.h>
+
+/**
+  Maps an entire file read-only. Pages are only read from disk as they are touched, so mapping a multi-hour
+  recording costs address space, not RAM. prefetch() and release() let a sequential reader keep the OS reading
+  ahead of it and drop what it has already consumed.
+ */
+class MemoryMappedFile {
+protected:
+    const uint8*    m_data;
+    size_t          m_size;
+
+#ifdef G3D_WINDOWS
+    void*           m_fileHandle;
+    void*           m_mappingHandle;
+#else
+    int             m_fileDescriptor;
+#endif
+
+public:
+
+    MemoryMappedFile();
+    ~MemoryMappedFile();
+
+    /** Returns false if the file could not be opened or mapped */
+    bool open(const String& filename);
+
+    void close();
+
+    bool isOpen() const {
+        return m_data != nullptr;
+    }
+
+    const uint8* data() const {
+        return m_data;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    /** Ask the OS to start reading [offset, offset + length) in the background (widened to whole pages) */
+    void prefetch(size_t offset, size_t length) const;
+
+    /** Tell the OS [offset, offset + length) won't be read again, so it can drop those pages. Only pages wholly
+        inside the range are dropped, since dropping one that is still partly unread would just fault it back in.
+        Returns where the next release() of a sequential reader should start: the end of the last page dropped,
+        or \a offset if none was */
+    size_t release(size_t offset, size_t length) const;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/** \file OnsetDetector.cpp */
+#include "OnsetDetector.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const float OnsetDetector::minimumThreshold = 1e-6f;
+
+OnsetDetector::BandState::BandState() :
+    flux(0.0f),
+    threshold(0.0f),
+    lastOnsetTime(-std::numeric_limits<double>::infinity()),
+    lastOnsetStrength(0.0f),
+    onsetCount(0) {}
+
+
+OnsetDetector::OnsetDetector() :
+    m_binCount(0),
+    m_thresholdLength(1),
+    m_previousTime(0.0),
+    m_position(0),
+    m_updateCount(0) {}
+
+
+void OnsetDetector::init(int binCount, double binWidth, double hopDuration, const Settings& settings) {
+    m_settings = settings;
+    m_binCount = binCount;
+    m_thresholdLength = std::max(1, (int)std::lround(settings.thresholdWindow / hopDuration));
+
+    const int bandCount = (int)settings.bands.size();
+    m_firstBin.resize(bandCount);
+    m_endBin.resize(bandCount);
+    for (int b = 0; b < bandCount; ++b) {
+        // Bin 0 holds DC and Nyquist packed together, so it never counts
+        const Band& band = settings.bands[b];
+        m_firstBin[b] = std::max(1, std::min(binCount, (int)std::ceil(band.minFrequency / binWidth)));
+        m_endBin[b] = std::max(m_firstBin[b], std::min(binCount, (int)std::floor(band.maxFrequency / binWidth) + 1));
+    }
+
+    m_previous.assign(binCount, 0.0f);
+    m_compressed.assign(binCount, 0.0f);
+    m_state.assign(bandCount, BandState());
+    m_fluxHistory.assign((size_t)bandCount * m_thresholdLength, 0.0f);
+    m_fluxSum.assign(bandCount, 0.0);
+    m_previousFlux.assign(bandCount, 0.0f);
+    m_previousThreshold.assign(bandCount, 0.0f);
+    m_twoBackFlux.assign(bandCount, 0.0f);
+    m_previousTime = 0.0;
+    m_position = 0;
+    m_updateCount = 0;
+    m_events.clear();
+    m_events.reserve(bandCount);
+}
+
+
+int OnsetDetector::update(const float* magnitudes, float fullScaleMagnitude, double streamTime) {
+    m_events.clear();
+    if (bandCount() == 0) {
+        return 0;
+    }
+
+    const float scale = (float)(m_settings.compression / fullScaleMagnitude);
+    for (int k = 0; k < m_binCount; ++k) {
+        m_compressed[k] = log1pf(scale * magnitudes[k]);
+    }
+
+    // How much of the threshold window has been filled, counting the flux about to be added
+    const int filled = (int)std::min<long>(m_updateCount, m_thresholdLength);
+    for (int b = 0; b < bandCount(); ++b) {
+        float sum = 0.0f;
+        for (int k = m_firstBin[b]; k < m_endBin[b]; ++k) {
+            sum += std::max(0.0f, m_compressed[k] - m_previous[k]);
+        }
+        const float flux = (m_endBin[b] > m_firstBin[b]) ? sum / (m_endBin[b] - m_firstBin[b]) : 0.0f;
+
+        BandState& state = m_state[b];
+        if (m_updateCount >= 2) {
+            // The previous flux is a peak if it rose from the one before and didn't rise into this one
+            const float candidate = m_previousFlux[b];
+            if ((candidate > m_twoBackFlux[b]) && (candidate >= flux) && (candidate > m_previousThreshold[b]) &&
+                (m_previousTime - state.lastOnsetTime >= m_settings.minimumInterval)) {
+                OnsetEvent event;
+                event.streamTime = m_previousTime;
+                event.band = b;
+                // thresholdOffset may be 0, so after silence the threshold can be too
+                event.strength = candidate / std::max(m_previousThreshold[b], minimumThreshold);
+                m_events.push_back(event);
+                state.lastOnsetTime = event.streamTime;
+                state.lastOnsetStrength = event.strength;
+                ++state.onsetCount;
+            }
+        }
+
+        float threshold = (float)m_settings.thresholdOffset;
+        if (m_updateCount >= 1) {
+            // Slide the previous flux into the window the new one is judged against
+            float& oldest = m_fluxHistory[(size_t)b * m_thresholdLength + m_position];
+            m_fluxSum[b] += m_previousFlux[b] - oldest;
+            oldest = m_previousFlux[b];
+            threshold += (float)(m_settings.thresholdRatio * std::max(0.0, m_fluxSum[b]) / filled);
+        }
+
+        state.flux = flux;
+        state.threshold = threshold;
+        m_twoBackFlux[b] = m_previousFlux[b];
+        m_previousFlux[b] = flux;
+        m_previousThreshold[b] = threshold;
+    }
+
+    if (m_updateCount >= 1) {
+        m_position = (m_position + 1) % m_thresholdLength;
+    }
+    m_previous.swap(m_compressed);
+    m_previousTime = streamTime;
+    ++m_updateCount;
+    return (int)m_events.size();
+}
@@ -0,0 +1,136 @@
+/**
+  \file OnsetDetector.h
+
+  Spectral-flux onset (transient) detection, one spectrum at a time. Like ThreadPool and SlidingDFT, this only
+  depends on the standard library.
+ */
+#ifndef OnsetDetector_h
+#define OnsetDetector_h
+
+#include <vector>
+
+/** An onset found by OnsetDetector */
+struct OnsetEvent {
+    /** Stream time (seconds) of the end of the spectrum's window, as passed to OnsetDetector::update() */
+    double  streamTime;
+    /** Index of the band it was found in */
+    int     band;
+    /** Flux over the threshold it had to beat (at least OnsetDetector::minimumThreshold, so this stays finite
+        after silence when Settings::thresholdOffset is 0); more than 1 unless the flux was tiny */
+    float   strength;
+
+    OnsetEvent() : streamTime(0.0), band(0), strength(0.0f) {}
+};
+
+/**
+  For every band (a frequency range; bands may overlap), the spectral flux of each new spectrum is the mean over
+  the band's bins of the half-wave rectified rise in log(1 + compression * magnitude): only bins getting louder
+  count, and the log keeps quiet bins from being drowned out by loud ones.
+
+  An onset is a peak of a band's flux that beats an adaptive threshold: thresholdRatio x the band's mean flux over
+  the last thresholdWindow seconds, plus thresholdOffset, so steady loud music doesn't fire all the time and
+  quiet passages still can. Peaks are only recognized once the flux starts falling again, so onsets are reported
+  one hop late, and at most one per band per minimumInterval seconds.
+ */
+class OnsetDetector {
+public:
+
+    struct Band {
+        double  minFrequency;
+        double  maxFrequency;
+
+        Band() : minFrequency(0.0), maxFrequency(0.0) {}
+
+        Band(double minFrequency, double maxFrequency) : minFrequency(minFrequency), maxFrequency(maxFrequency) {}
+    };
+
+    struct Settings {
+        /** Empty turns the detector off */
+        std::vector<Band>   bands;
+        /** Flux is measured on log(1 + compression * magnitude), magnitudes relative to full scale */
+        double              compression;
+        /** Seconds of past flux the threshold averages */
+        double              thresholdWindow;
+        /** threshold = thresholdRatio x mean flux + thresholdOffset */
+        double              thresholdRatio;
+        double              thresholdOffset;
+        /** Seconds between onsets in one band */
+        double              minimumInterval;
+
+        Settings() : compression(100.0), thresholdWindow(0.5), thresholdRatio(1.5), thresholdOffset(0.01), minimumInterval(0.05) {}
+    };
+
+    /** Where a band stands after the latest update() */
+    struct BandState {
+        /** Flux of the newest spectrum, and the threshold a peak there would have to beat */
+        float   flux;
+        float   threshold;
+        /** Stream time and strength of the band's last onset; the time is -infinity before the first one */
+        double  lastOnsetTime;
+        float   lastOnsetStrength;
+        int     onsetCount;
+
+        BandState();
+    };
+
+    /** Smallest threshold strengths are measured against */
+    static const float                  minimumThreshold;
+
+protected:
+
+    Settings                            m_settings;
+    int                                 m_binCount;
+    int                                 m_thresholdLength;
+
+    /** Bins [m_firstBin[b], m_endBin[b]) make up band b */
+    std::vector<int>                    m_firstBin;
+    std::vector<int>                    m_endBin;
+
+    /** Compressed magnitudes of the previous spectrum */
+    std::vector<float>                  m_previous;
+    std::vector<float>                  m_compressed;
+
+    std::vector<BandState>              m_state;
+
+    /** Each band's last m_thresholdLength fluxes before the newest, as rings (band-major) whose oldest entry is at
+        m_position, and their sums. The previous flux is the next peak candidate, so it is kept along with its
+        threshold and the flux before it */
+    std::vector<float>                  m_fluxHistory;
+    std::vector<double>                 m_fluxSum;
+    std::vector<float>                  m_previousFlux;
+    std::vector<float>                  m_previousThreshold;
+    std::vector<float>                  m_twoBackFlux;
+    double                              m_previousTime;
+    int                                 m_position;
+    long                                m_updateCount;
+
+    /** Onsets found by the last update() */
+    std::vector<OnsetEvent>             m_events;
+
+public:
+
+    OnsetDetector();
+
+    /** Detect onsets in \a settings' bands of spectra of \a binCount bins, \a binWidth Hz apart, that arrive every
+        \a hopDuration seconds, and forget everything seen so far */
+    void init(int binCount, double binWidth, double hopDuration, const Settings& settings);
+
+    int bandCount() const {
+        return (int)m_state.size();
+    }
+
+    const BandState& state(int band) const {
+        return m_state[band];
+    }
+
+    /** Feed the next spectrum: binCount() magnitudes, scaled so that \a fullScaleMagnitude is a full-scale sine,
+        whose window ends at \a streamTime. Returns the number of onsets found, which are then in events() */
+    int update(const float* magnitudes, float fullScaleMagnitude, double streamTime);
+
+    /** Onsets found by the last update(), at most one per band */
+    const std::vector<OnsetEvent>& events() const {
+        return m_events;
+    }
+};
+
+#endif
@@ -0,0 +1,232 @@
+/** \file SlidingDFT.cpp */
+#include "SlidingDFT.h"
+#include <algorithm>
+#include <cmath>
+
+SlidingDFT::SlidingDFT() :
+    m_windowLength(0),
+    m_blockLength(1),
+    m_blockCount(0),
+    m_hannWindow(false),
+    m_blockFill(0),
+    m_oldestBlock(0) {}
+
+
+int SlidingDFT::trackBin(int bin) {
+    // Bins below 0 or above N/2 wrap around; the window is real, so that's the conjugate of the mirrored bin,
+    // but it's simplest to just track it too
+    const int k = ((bin % m_windowLength) + m_windowLength) % m_windowLength;
+    for (int i = 0; i < (int)m_trackedBins.size(); ++i) {
+        if (m_trackedBins[i] == k) {
+            return i;
+        }
+    }
+    m_trackedBins.push_back(k);
+    return (int)m_trackedBins.size() - 1;
+}
+
+
+void SlidingDFT::init(int windowLength, int hopLength, const std::vector<int>& bins, bool hannWindow) {
+    m_windowLength = windowLength;
+    m_hannWindow = hannWindow;
+    m_bins = bins;
+
+    // Every hop has to end on a block boundary, and the window has to be whole blocks
+    int a = std::max(1, windowLength);
+    int b = std::max(1, hopLength);
+    while (b != 0) {
+        const int r = a % b;
+        a = b;
+        b = r;
+    }
+    m_blockLength = a;
+    m_blockCount = windowLength / m_blockLength;
+
+    m_trackedBins.clear();
+    m_center.resize(bins.size());
+    m_below.resize(bins.size());
+    m_above.resize(bins.size());
+    for (size_t i = 0; i < bins.size(); ++i) {
+        m_center[i] = trackBin(bins[i]);
+        if (hannWindow) {
+            m_below[i] = trackBin(bins[i] - 1);
+            m_above[i] = trackBin(bins[i] + 1);
+        }
+    }
+
+    // Pad to whole groups with bins whose twiddles are all zero; update() computes them but nothing reads them
+    const double twoPi = 6.283185307179586;
+    const int trackedCount = trackedBinCount();
+    const int paddedCount = (trackedCount + binGroupSize - 1) / binGroupSize * binGroupSize;
+    m_twiddleRe.assign((size_t)paddedCount * m_blockLength, 0.0f);
+    m_twiddleIm.assign((size_t)paddedCount * m_blockLength, 0.0f);
+    m_slotRotation.resize((size_t)trackedCount * m_blockCount);
+    for (int i = 0; i < trackedCount; ++i) {
+        // Reduce k j mod N first so the angle stays small and exact
+        const long long k = m_trackedBins[i];
+        const int group = i / binGroupSize;
+        for (int j = 0; j < m_blockLength; ++j) {
+            const double angle = twoPi * ((k * j) % windowLength) / windowLength;
+            const size_t index = ((size_t)group * m_blockLength + j) * binGroupSize + i % binGroupSize;
+            m_twiddleRe[index] = (float)std::cos(angle);
+            m_twiddleIm[index] = (float)std::sin(angle);
+        }
+        for (int slot = 0; slot < m_blockCount; ++slot) {
+            m_slotRotation[(size_t)slot * trackedCount + i] = std::polar(1.0, twoPi * ((k * m_blockLength * slot) % windowLength) / windowLength);
+        }
+    }
+    m_blockRe.resize(paddedCount);
+    m_blockIm.resize(paddedCount);
+    m_partialRe.resize((size_t)trackedCount * m_blockCount);
+    m_partialIm.resize((size_t)trackedCount * m_blockCount);
+    m_windowRe.resize(trackedCount);
+    m_windowIm.resize(trackedCount);
+    reset();
+}
+
+
+void SlidingDFT::reset() {
+    std::fill(m_blockRe.begin(), m_blockRe.end(), 0.0f);
+    std::fill(m_blockIm.begin(), m_blockIm.end(), 0.0f);
+    std::fill(m_partialRe.begin(), m_partialRe.end(), 0.0);
+    std::fill(m_partialIm.begin(), m_partialIm.end(), 0.0);
+    std::fill(m_windowRe.begin(), m_windowRe.end(), 0.0);
+    std::fill(m_windowIm.begin(), m_windowIm.end(), 0.0);
+    m_blockFill = 0;
+    m_oldestBlock = 0;
+}
+
+
+void SlidingDFT::update(const float* samples, int count) {
+    const int paddedCount = (int)m_blockRe.size();
+    if (paddedCount == 0) {
+        return;
+    }
+
+    bool windowChanged = false;
+    int n = 0;
+    while (n < count) {
+        const int length = std::min(count - n, m_blockLength - m_blockFill);
+
+        // One group of bins at a time, with its partials in locals for the whole chunk so they can't alias the
+        // tables. The loop over a group is a fixed length with the same work for every bin, which compilers turn
+        // into SIMD even without fast-math or runtime alias checks
+        for (int group = 0; group < paddedCount; group += binGroupSize) {
+            float re[binGroupSize];
+            float im[binGroupSize];
+            for (int i = 0; i < binGroupSize; ++i) {
+                re[i] = m_blockRe[group + i];
+                im[i] = m_blockIm[group + i];
+            }
+            const size_t first = ((size_t)group * m_blockLength / binGroupSize + m_blockFill) * binGroupSize;
+            const float* twiddleRe = m_twiddleRe.data() + first;
+            const float* twiddleIm = m_twiddleIm.data() + first;
+            int j = 0;
+            for (; j + 4 <= length; j += 4) {
+                // Four samples per update of the partials, which keeps the adds into them from being a chain
+                // as long as the block
+                const float* x = samples + n + j;
+                for (int i = 0; i < binGroupSize; ++i) {
+                    re[i] += (x[0] * twiddleRe[i] + x[1] * twiddleRe[binGroupSize + i]) +
+                             (x[2] * twiddleRe[2 * binGroupSize + i] + x[3] * twiddleRe[3 * binGroupSize + i]);
+                    im[i] += (x[0] * twiddleIm[i] + x[1] * twiddleIm[binGroupSize + i]) +
+                             (x[2] * twiddleIm[2 * binGroupSize + i] + x[3] * twiddleIm[3 * binGroupSize + i]);
+                }
+                twiddleRe += 4 * binGroupSize;
+                twiddleIm += 4 * binGroupSize;
+            }
+            for (; j < length; ++j) {
+                const float x = samples[n + j];
+                for (int i = 0; i < binGroupSize; ++i) {
+                    re[i] += x * twiddleRe[i];
+                    im[i] += x * twiddleIm[i];
+                }
+                twiddleRe += binGroupSize;
+                twiddleIm += binGroupSize;
+            }
+            for (int i = 0; i < binGroupSize; ++i) {
+                m_blockRe[group + i] = re[i];
+                m_blockIm[group + i] = im[i];
+            }
+        }
+        n += length;
+        m_blockFill += length;
+
+        if (m_blockFill == m_blockLength) {
+            // The finished block replaces the oldest one, and the next oldest becomes the first in the window
+            const size_t first = (size_t)m_oldestBlock * trackedBinCount();
+            for (int i = 0; i < trackedBinCount(); ++i) {
+                const std::complex<double> rotation = m_slotRotation[first + i];
+                m_partialRe[first + i] = m_blockRe[i] * rotation.real() - m_blockIm[i] * rotation.imag();
+                m_partialIm[first + i] = m_blockRe[i] * rotation.imag() + m_blockIm[i] * rotation.real();
+            }
+            std::fill(m_blockRe.begin(), m_blockRe.end(), 0.0f);
+            std::fill(m_blockIm.begin(), m_blockIm.end(), 0.0f);
+            m_oldestBlock = (m_oldestBlock + 1) % m_blockCount;
+            m_blockFill = 0;
+            windowChanged = true;
+        }
+    }
+
+    if (windowChanged) {
+        sumWindow();
+    }
+}
+
+
+void SlidingDFT::sumWindow() {
+    // Block b of the window (0 = oldest) should be turned by R^b, R = exp(2 pi i k blockLength / N). R^blockCount
+    // is 1, so that's R^slot R^-oldest: the partials were already turned by R^slot as they were stored, which
+    // leaves one rotation for the whole sum. Every sum starts from scratch, so rounding errors never build up
+    const int trackedCount = trackedBinCount();
+    std::fill(m_windowRe.begin(), m_windowRe.end(), 0.0);
+    std::fill(m_windowIm.begin(), m_windowIm.end(), 0.0);
+    for (int slot = 0; slot < m_blockCount; ++slot) {
+        const double* partialRe = m_partialRe.data() + (size_t)slot * trackedCount;
+        const double* partialIm = m_partialIm.data() + (size_t)slot * trackedCount;
+        for (int i = 0; i < trackedCount; ++i) {
+            m_windowRe[i] += partialRe[i];
+            m_windowIm[i] += partialIm[i];
+        }
+    }
+    const std::complex<double>* rotation = m_slotRotation.data() + (size_t)m_oldestBlock * trackedCount;
+    for (int i = 0; i < trackedCount; ++i) {
+        const double re = m_windowRe[i];
+        const double im = m_windowIm[i];
+        m_windowRe[i] = re * rotation[i].real() + im * rotation[i].imag();
+        m_windowIm[i] = im * rotation[i].real() - re * rotation[i].imag();
+    }
+}
+
+
+std::complex<double> SlidingDFT::value(int i) const {
+    std::complex<double> v = trackedValue(m_center[i]);
+    if (m_hannWindow) {
+        // Hann window 0.5 - 0.25 (W^m + W^-m) is a 3-tap convolution in frequency
+        v = 0.5 * v - 0.25 * (trackedValue(m_below[i]) + trackedValue(m_above[i]));
+    }
+    // Same 1/N scale as rfft()
+    return v / (double)m_windowLength;
+}
+
+
+void SlidingDFT::magnitudes(float* out) const {
+    for (int i = 0; i < binCount(); ++i) {
+        out[i] = (float)std::abs(value(i));
+    }
+}
+
+
+std::vector<int> SlidingDFT::logSpacedBins(int windowLength, double sampleRate, double minFrequency, double maxFrequency, int count) {
+    std::vector<int> bins;
+    const double binWidth = sampleRate / windowLength;
+    for (int i = 0; i < count; ++i) {
+        const double alpha = (count > 1) ? i / (double)(count - 1) : 0.0;
+        const double frequency = minFrequency * std::pow(maxFrequency / minFrequency, alpha);
+        const int bin = std::max(1, std::min(windowLength / 2 - 1, (int)(frequency / binWidth + 0.5)));
+        if (bins.empty() || (bins.back() != bin)) {
+            bins.push_back(bin);
+        }
+    }
+    return bins;
+}
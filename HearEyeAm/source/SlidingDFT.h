@@ -0,0 +1,140 @@
+/**
+  \file SlidingDFT.h
+
+  Sliding DFT of a few tracked bins of a long window, updated as samples arrive and read once per hop. Like
+  ThreadPool, this only depends on the standard library.
+ */
+#ifndef SlidingDFT_h
+#define SlidingDFT_h
+
+#include <complex>
+#include <vector>
+
+/**
+  Keeps bins k of the DFT of the last windowLength() samples up to date, for less than a whole FFT per hop when
+  only a few bins are wanted. The result matches what rfft() of the same window would give for those bins
+  (same sign and 1/N scale), optionally Hann windowed.
+
+  The window is cut into blocks of blockLength() = gcd(windowLength, hopLength) samples. As a block arrives,
+  update() correlates it with exp(+2 pi i k j / N) for every tracked bin (2 real multiply-adds per tracked bin
+  per sample, in float, vectorized across bins). Each update() that completes a block then sums the partials of
+  the window's windowLength() / blockLength() blocks, each rotated by its offset into the window (in double).
+  Nothing is recursive, so there is no drift and no damping: the output is exact up to float rounding of each
+  block's partial (fftbench's sliding_dft case measures about 1e-7 of the largest bin of the whole spectrum).
+
+  Per hop and per tracked bin that is 2 x hopLength real multiply-adds plus windowLength / blockLength complex
+  adds. A Hann window tracks each requested bin's two neighbours too (shared between adjacent requested
+  bins), so it costs up to 3x as much as none. The cost is linear in the number of tracked bins while an FFT's
+  is fixed, so this only wins for a few: the app's 24 Hann-windowed bins of a 4096-sample window every 256
+  samples (about 65 tracked) measure about 5.5 us per hop against 14 us for a windowed AVX2 rfft_stockham
+  (fftbench's sliding_dft case, about 40%), which puts the break-even around 60 requested bins. The hop should
+  share a large power of 2 with the window: a hop of 1 makes every block a single sample, and summing the
+  window a full DFT of it every hop.
+ */
+class SlidingDFT {
+protected:
+    /** update() works on this many tracked bins at a time: two SSE or NEON registers (or one AVX one) each of
+        real and imaginary partials */
+    enum { binGroupSize = 8 };
+
+    int                                 m_windowLength;
+    int                                 m_blockLength;
+    /** windowLength / blockLength */
+    int                                 m_blockCount;
+    bool                                m_hannWindow;
+
+    /** The bins asked for in init() */
+    std::vector<int>                    m_bins;
+
+    /** Every bin actually tracked: the requested ones, plus their neighbours when windowing */
+    std::vector<int>                    m_trackedBins;
+
+    /** exp(+2 pi i k j / N) for j < blockLength, for groups of binGroupSize tracked bins (padded with zeros):
+        entry (group * blockLength + j) * binGroupSize + i is bin group * binGroupSize + i, so update() reads each
+        group's table front to back and vectorizes across the bins in it */
+    std::vector<float>                  m_twiddleRe;
+    std::vector<float>                  m_twiddleIm;
+
+    /** The partial of the block being filled, so far, for each tracked bin (padded to whole groups) */
+    std::vector<float>                  m_blockRe;
+    std::vector<float>                  m_blockIm;
+    int                                 m_blockFill;
+
+    /** exp(2 pi i k blockLength slot / N) for each slot of the ring below (slot-major) and tracked bin */
+    std::vector<std::complex<double> >  m_slotRotation;
+
+    /** The partials of the last m_blockCount complete blocks, each turned by its slot's rotation, as a ring of
+        slots (slot-major) whose oldest block is at m_oldestBlock */
+    std::vector<double>                 m_partialRe;
+    std::vector<double>                 m_partialIm;
+    int                                 m_oldestBlock;
+
+    /** DFT of the window for each tracked bin, unwindowed and unscaled, as of the last complete block */
+    std::vector<double>                 m_windowRe;
+    std::vector<double>                 m_windowIm;
+
+    /** For each requested bin, the index of it (and of k - 1 and k + 1 when windowing) in m_trackedBins */
+    std::vector<int>                    m_center;
+    std::vector<int>                    m_below;
+    std::vector<int>                    m_above;
+
+    int trackBin(int bin);
+
+    /** Recompute m_windowRe and m_windowIm from the partials */
+    void sumWindow();
+
+    std::complex<double> trackedValue(int t) const {
+        return std::complex<double>(m_windowRe[t], m_windowIm[t]);
+    }
+
+public:
+
+    SlidingDFT();
+
+    /** Track \a bins (0 <= bin < windowLength / 2) of a \a windowLength-sample window that will be read every
+        \a hopLength samples, and forget all samples. With \a hannWindow, the bins are Hann windowed in the
+        frequency domain, which also tracks each bin's two neighbours. */
+    void init(int windowLength, int hopLength, const std::vector<int>& bins, bool hannWindow = true);
+
+    /** Zero the window and every bin */
+    void reset();
+
+    int windowLength() const {
+        return m_windowLength;
+    }
+
+    int blockLength() const {
+        return m_blockLength;
+    }
+
+    /** Number of requested bins */
+    int binCount() const {
+        return (int)m_bins.size();
+    }
+
+    /** Number of bins update() actually computes */
+    int trackedBinCount() const {
+        return (int)m_trackedBins.size();
+    }
+
+    int bin(int i) const {
+        return m_bins[i];
+    }
+
+    /** Push \a count new samples through the window */
+    void update(const float* samples, int count);
+
+    /** Current value of requested bin \a i, for the window ending at the last complete block (i.e. exactly the
+        last windowLength() samples whenever a multiple of blockLength() samples has been pushed, which every hop
+        is) */
+    std::complex<double> value(int i) const;
+
+    /** Magnitudes of all binCount() requested bins */
+    void magnitudes(float* out) const;
+
+    /** \a count bins of a \a windowLength-sample transform spaced evenly in log frequency between \a minFrequency
+        and \a maxFrequency (Hz), with duplicates (which happen at the low end) removed */
+    static std::vector<int> logSpacedBins(int windowLength, double sampleRate, double minFrequency, double maxFrequency, int count);
+};
+
+#endif
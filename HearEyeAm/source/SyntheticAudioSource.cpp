@@ -0,0 +1,124 @@
+/** \file SyntheticAudioSource.cpp */
+#include "SyntheticAudioSource.h"
+
+SyntheticAudioSource::SyntheticAudioSource(const Settings& settings) :
+    m_settings(settings),
+    m_sampleIndex(0),
+    m_sweepPhase(0.0),
+    m_noiseState(0x9E3779B97F4A7C15ull) {
+    m_chordPhases.resize(settings.chordFrequencies.size());
+    m_chordPhases.setAll(0.0);
+    for (int i = 0; i < 7; ++i) {
+        m_pink[i] = 0.0f;
+    }
+}
+
+
+SyntheticAudioSource::~SyntheticAudioSource() {
+    // Our thread calls readBlock(), so it has to stop before our state goes away
+    stop();
+}
+
+
+shared_ptr<SyntheticAudioSource> SyntheticAudioSource::create(const Settings& settings) {
+    return shared_ptr<SyntheticAudioSource>(new SyntheticAudioSource(settings));
+}
+
+
+float SyntheticAudioSource::whiteNoise() {
+    // xorshift64*
+    m_noiseState ^= m_noiseState >> 12;
+    m_noiseState ^= m_noiseState << 25;
+    m_noiseState ^= m_noiseState >> 27;
+    const uint64 bits = m_noiseState * 0x2545F4914F6CDD1Dull;
+    // Top 24 bits -> [0, 1) -> [-1, 1)
+    return (float)(bits >> 40) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+
+float SyntheticAudioSource::pinkNoise() {
+    // Paul Kellet's refined -3 dB/octave filter on white noise
+    const float white = whiteNoise();
+    m_pink[0] = 0.99886f * m_pink[0] + white * 0.0555179f;
+    m_pink[1] = 0.99332f * m_pink[1] + white * 0.0750759f;
+    m_pink[2] = 0.96900f * m_pink[2] + white * 0.1538520f;
+    m_pink[3] = 0.86650f * m_pink[3] + white * 0.3104856f;
+    m_pink[4] = 0.55000f * m_pink[4] + white * 0.5329522f;
+    m_pink[5] = -0.7616f * m_pink[5] - white * 0.0168980f;
+    const float pink = m_pink[0] + m_pink[1] + m_pink[2] + m_pink[3] + m_pink[4] + m_pink[5] + m_pink[6] + white * 0.5362f;
+    m_pink[6] = white * 0.115926f;
+    // The filter has a gain of about 5; bring it back to roughly [-1, 1]
+    return pink * 0.2f;
+}
+
+
+bool SyntheticAudioSource::readBlock(float* block) {
+    const double sampleRate = m_settings.sampleRate;
+    const float amplitude = m_settings.amplitude;
+
+    switch (m_settings.signal) {
+    case Signal::SINE_SWEEP:
+        {
+            const double sweepSamples = max(1.0, m_settings.sweepDuration * sampleRate);
+            const double ratio = m_settings.sweepEndFrequency / (double)m_settings.sweepStartFrequency;
+            for (int i = 0; i < m_framesPerBlock; ++i) {
+                // Exponential sweep; integrate the instantaneous frequency so the phase stays continuous
+                const double t = fmod((double)(m_sampleIndex + i), sweepSamples) / sweepSamples;
+                const double frequency = m_settings.sweepStartFrequency * pow(ratio, t);
+                block[i] = amplitude * (float)sin(2.0 * pi() * m_sweepPhase);
+                m_sweepPhase = fmod(m_sweepPhase + frequency / sampleRate, 1.0);
+            }
+        }
+        break;
+
+    case Signal::CHORD:
+        {
+            const int toneCount = m_settings.chordFrequencies.size();
+            const float toneAmplitude = (toneCount > 0) ? amplitude / toneCount : 0.0f;
+            for (int i = 0; i < m_framesPerBlock; ++i) {
+                float sum = 0.0f;
+                for (int t = 0; t < toneCount; ++t) {
+                    sum += (float)sin(2.0 * pi() * m_chordPhases[t]);
+                    m_chordPhases[t] = fmod(m_chordPhases[t] + m_settings.chordFrequencies[t] / sampleRate, 1.0);
+                }
+                block[i] = toneAmplitude * sum;
+            }
+        }
+        break;
+
+    case Signal::WHITE_NOISE:
+        for (int i = 0; i < m_framesPerBlock; ++i) {
+            block[i] = amplitude * whiteNoise();
+        }
+        break;
+
+    case Signal::PINK_NOISE:
+        for (int i = 0; i < m_framesPerBlock; ++i) {
+            block[i] = amplitude * pinkNoise();
+        }
+        break;
+
+    case Signal::IMPULSE_TRAIN:
+        {
+            const uint64 period = (uint64)max(1.0, sampleRate / max(0.001, (double)m_settings.impulseFrequency));
+            for (int i = 0; i < m_framesPerBlock; ++i) {
+                block[i] = (((m_sampleIndex + i) % period) == 0) ? amplitude : 0.0f;
+            }
+        }
+        break;
+    }
+
+    // Every channel carries the same signal. Spread the frames out from the back so nothing is overwritten before it is read
+    if (m_channelsPerFrame > 1) {
+        for (int i = m_framesPerBlock - 1; i >= 0; --i) {
+            const float value = block[i];
+            for (int c = 0; c < m_channelsPerFrame; ++c) {
+                block[i * m_channelsPerFrame + c] = value;
+            }
+        }
+    }
+
+    m_sampleIndex += m_framesPerBlock;
+    // Never runs out
+    return true;
+}
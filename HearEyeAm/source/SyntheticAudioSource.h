@@ -0,0 +1,90 @@
+/**
+  \file SyntheticAudioSource.h
+
+  Deterministic test signals, for benchmarking the whole pipeline without a sound card.
+ */
+#ifndef SyntheticAudioSource_h
+#define SyntheticAudioSource_h
+
+#include <G3D/G3DAll.h>
+#include "AudioSource.h"
+
+/**
+  AudioSource that generates known signals on its own clock. The output only depends on the Settings and
+  the block size (the noise generators use a fixed seed), so runs are exactly reproducible.
+ */
+class SyntheticAudioSource : public AudioSource {
+public:
+    G3D_DECLARE_ENUM_CLASS(Signal,
+        SINE_SWEEP,
+        CHORD,
+        WHITE_NOISE,
+        PINK_NOISE,
+        IMPULSE_TRAIN);
+
+    struct Settings {
+        Signal          signal;
+        int             sampleRate;
+        /** Peak amplitude of the signal */
+        float           amplitude;
+
+        /** SINE_SWEEP goes exponentially from sweepStartFrequency to sweepEndFrequency (Hz) every sweepDuration seconds */
+        float           sweepStartFrequency;
+        float           sweepEndFrequency;
+        float           sweepDuration;
+
+        /** CHORD sums equal-amplitude sines at these frequencies (Hz) */
+        Array<float>    chordFrequencies;
+
+        /** IMPULSE_TRAIN emits a single full-amplitude sample this many times per second */
+        float           impulseFrequency;
+
+        Settings() :
+            signal(Signal::SINE_SWEEP),
+            sampleRate(48000),
+            amplitude(0.5f),
+            sweepStartFrequency(20.0f),
+            sweepEndFrequency(20000.0f),
+            sweepDuration(10.0f),
+            impulseFrequency(2.0f) {
+            // A major
+            chordFrequencies.append(220.0f, 277.18f, 329.63f, 440.0f);
+        }
+    };
+
+protected:
+    Settings            m_settings;
+
+    /** Samples generated so far */
+    uint64              m_sampleIndex;
+
+    /** Phase (in cycles) of the sweep, and of each chord tone */
+    double              m_sweepPhase;
+    Array<double>       m_chordPhases;
+
+    /** xorshift state for the noise generators */
+    uint64              m_noiseState;
+    /** Pink noise filter state */
+    float               m_pink[7];
+
+    SyntheticAudioSource(const Settings& settings);
+
+    /** Uniform in [-1, 1] */
+    float whiteNoise();
+
+    float pinkNoise();
+
+    virtual bool readBlock(float* block) override;
+
+public:
+
+    virtual ~SyntheticAudioSource();
+
+    static shared_ptr<SyntheticAudioSource> create(const Settings& settings);
+
+    virtual int sampleRate() const override {
+        return m_settings.sampleRate;
+    }
+};
+
+#endif
@@ -0,0 +1,89 @@
+/** \file ThreadPool.cpp */
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int workerCount) :
+    m_generation(0),
+    m_shuttingDown(false),
+    m_task(nullptr),
+    m_taskCount(0),
+    m_nextIndex(0),
+    m_busyWorkers(0) {
+
+    if (workerCount < 0) {
+        const int hardwareThreads = (int)std::thread::hardware_concurrency();
+        workerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        m_workers.push_back(std::thread(&ThreadPool::workerMain, this));
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shuttingDown = true;
+    }
+    m_workAvailable.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+
+void ThreadPool::runTasks() {
+    for (int i = m_nextIndex.fetch_add(1); i < m_taskCount; i = m_nextIndex.fetch_add(1)) {
+        (*m_task)(i);
+    }
+}
+
+
+void ThreadPool::workerMain() {
+    uint64_t lastGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [&] { return m_shuttingDown || (m_generation != lastGeneration); });
+            if (m_shuttingDown) {
+                return;
+            }
+            lastGeneration = m_generation;
+        }
+
+        runTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_busyWorkers;
+        }
+        m_workDone.notify_one();
+    }
+}
+
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+    if ((count <= 1) || m_workers.empty()) {
+        // Not worth waking anybody up
+        for (int i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_taskCount = count;
+        m_nextIndex = 0;
+        m_busyWorkers = (int)m_workers.size();
+        ++m_generation;
+    }
+    m_workAvailable.notify_all();
+
+    runTasks();
+
+    // Every worker has to check in before task goes out of scope, even the ones that found nothing left to do
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_workDone.wait(lock, [&] { return m_busyWorkers == 0; });
+    m_task = nullptr;
+}
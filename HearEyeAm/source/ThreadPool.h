@@ -0,0 +1,64 @@
+/**
+  \file ThreadPool.h
+
+  Minimal fixed-size pool of worker threads for data-parallel loops. Deliberately only depends on the
+  standard library so that it can be shared with tools that don't link G3D.
+ */
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+  A fixed set of worker threads that run parallelFor() loops. The calling thread works on the loop too,
+  so a pool with zero workers simply runs everything inline.
+
+  parallelFor() may only be called from one thread at a time.
+ */
+class ThreadPool {
+protected:
+    std::vector<std::thread>        m_workers;
+
+    std::mutex                      m_mutex;
+    std::condition_variable         m_workAvailable;
+    std::condition_variable         m_workDone;
+
+    /** Incremented for every parallelFor(), so workers can tell a new loop from a spurious wakeup */
+    uint64_t                        m_generation;
+    bool                            m_shuttingDown;
+
+    /** The loop currently running */
+    const std::function<void(int)>* m_task;
+    int                             m_taskCount;
+    std::atomic<int>                m_nextIndex;
+    /** Workers that haven't finished the current loop yet */
+    int                             m_busyWorkers;
+
+    void workerMain();
+
+    /** Claim and run indices of the current loop until there are none left */
+    void runTasks();
+
+public:
+
+    /** \a workerCount extra threads; -1 means one fewer than the number of hardware threads */
+    explicit ThreadPool(int workerCount = -1);
+
+    ~ThreadPool();
+
+    /** Number of threads that work on a loop, including the caller */
+    int threadCount() const {
+        return (int)m_workers.size() + 1;
+    }
+
+    /** Call task(i) for every i in [0, count), spread across the workers and the calling thread.
+        Returns once every call has finished. */
+    void parallelFor(int count, const std::function<void(int)>& task);
+};
+
+#endif
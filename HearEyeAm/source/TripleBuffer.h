@@ -0,0 +1,78 @@
+/**
+  \file TripleBuffer.h
+
+  Wait-free single-writer/single-reader triple buffer.
+ */
+#ifndef TripleBuffer_h
+#define TripleBuffer_h
+
+#include <atomic>
+
+/**
+  Three instances of T shared between one writer thread and one reader thread.
+
+  The writer fills back() and calls publish(); the reader calls update() and then reads front().
+  Neither side ever waits for the other: publish() and update() are a single atomic exchange each.
+  The reader always sees the most recently published value, and a value it is reading is never
+  written to until the reader calls update() again. Values published in between two reader updates
+  are skipped, so anything that must not be lost has to be accumulated inside T by the writer.
+ */
+template<class T>
+class TripleBuffer {
+protected:
+    enum { INDEX_MASK = 3, FRESH_BIT = 4 };
+
+    T                   m_slot[3];
+
+    /** Index of the slot neither side currently owns, plus FRESH_BIT if the writer has published into it
+        since the reader last took it */
+    std::atomic<int>    m_middle;
+
+    /** Only touched by the writer */
+    int                 m_back;
+
+    /** Only touched by the reader */
+    int                 m_front;
+
+public:
+
+    TripleBuffer() : m_middle(1), m_back(0), m_front(2) {}
+
+    /** Forget any published value the reader hasn't taken yet. Only call while neither side is running. */
+    void reset() {
+        m_middle = m_middle & INDEX_MASK;
+    }
+
+    /** Direct access to every slot, e.g. to preallocate storage. Only call while neither side is running. */
+    T& slot(int i) {
+        return m_slot[i];
+    }
+
+    /** Writer only. The slot to fill in before the next publish(). It holds whatever the writer put into it
+        two publishes ago (or older), not the latest published value. */
+    T& back() {
+        return m_slot[m_back];
+    }
+
+    /** Writer only. Make back() visible to the reader and take a different slot to write into */
+    void publish() {
+        m_back = m_middle.exchange(m_back | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    /** Reader only. Take the most recently published value, if there is one the reader hasn't seen yet.
+        Returns true if front() changed. */
+    bool update() {
+        if ((m_middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    /** Reader only. The value taken by the last update() */
+    const T& front() const {
+        return m_slot[m_front];
+    }
+};
+
+#endif
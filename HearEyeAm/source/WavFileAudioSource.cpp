@@ -0,0 +1,200 @@
+/** \file WavFileAudioSource.cpp */
+#include "WavFileAudioSource.h"
+
+/** How far ahead of the read position we ask the OS to read, and how much we consume before releasing it */
+static const size_t READ_AHEAD_BYTES = 4 * 1024 * 1024;
+
+static uint16 readLE16(const uint8* p) {
+    return (uint16)(p[0] | (p[1] << 8));
+}
+
+static uint32 readLE32(const uint8* p) {
+    return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+
+WavFileAudioSource::WavFileAudioSource() :
+    m_dataOffset(0),
+    m_frameCount(0),
+    m_channelCount(1),
+    m_sampleRate(48000),
+    m_format(SampleFormat::FLOAT32),
+    m_bytesPerSample(4),
+    m_position(0),
+    m_loop(false),
+    m_prefetchedEnd(0),
+    m_releasedEnd(0) {}
+
+
+WavFileAudioSource::~WavFileAudioSource() {
+    // Our thread calls readBlock(), so it has to stop before m_file goes away
+    stop();
+}
+
+
+shared_ptr<WavFileAudioSource> WavFileAudioSource::create(const String& filename, bool loop, int rawSampleRate) {
+    shared_ptr<WavFileAudioSource> source(new WavFileAudioSource());
+    source->m_loop = loop;
+    if (!source->m_file.open(filename)) {
+        debugPrintf("Could not open audio file %s\n", filename.c_str());
+        return nullptr;
+    }
+
+    if (endsWith(toLower(filename), ".wav")) {
+        if (!source->parseWavHeader()) {
+            debugPrintf("%s is not a WAV file we can play\n", filename.c_str());
+            return nullptr;
+        }
+    } else {
+        // Headerless mono float PCM
+        source->m_sampleRate = rawSampleRate;
+        source->m_dataOffset = 0;
+        source->m_frameCount = source->m_file.size() / sizeof(float);
+    }
+
+    if (source->m_frameCount == 0) {
+        debugPrintf("%s contains no audio\n", filename.c_str());
+        return nullptr;
+    }
+    return source;
+}
+
+
+bool WavFileAudioSource::parseWavHeader() {
+    const uint8* data = m_file.data();
+    const size_t size = m_file.size();
+    if ((size < 12) || (memcmp(data, "RIFF", 4) != 0) || (memcmp(data + 8, "WAVE", 4) != 0)) {
+        return false;
+    }
+
+    bool foundFormat = false;
+    int formatTag = 0;
+    int bitsPerSample = 0;
+    size_t dataSize = 0;
+    bool foundData = false;
+
+    // Walk the chunks; "fmt " has to come before "data"
+    size_t offset = 12;
+    while (!foundData && (offset + 8 <= size)) {
+        const uint8* chunk = data + offset;
+        const size_t chunkSize = readLE32(chunk + 4);
+        const size_t body = offset + 8;
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if ((chunkSize < 16) || (body + chunkSize > size)) {
+                return false;
+            }
+            formatTag       = readLE16(data + body);
+            m_channelCount  = readLE16(data + body + 2);
+            m_sampleRate    = (int)readLE32(data + body + 4);
+            bitsPerSample   = readLE16(data + body + 14);
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format tag at the start of the subformat GUID
+            if ((formatTag == 0xFFFE) && (chunkSize >= 40)) {
+                formatTag = readLE16(data + body + 24);
+            }
+            foundFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!foundFormat) {
+                return false;
+            }
+            m_dataOffset = body;
+            // Recordings that were cut off may claim more data than the file holds
+            dataSize = min(chunkSize, size - body);
+            foundData = true;
+        }
+        // Chunks are padded to an even size
+        offset = body + chunkSize + (chunkSize & 1);
+    }
+
+    if (!foundData || (m_channelCount < 1) || (m_sampleRate <= 0)) {
+        return false;
+    }
+
+    if ((formatTag == 1) && (bitsPerSample == 16)) {
+        m_format = SampleFormat::INT16;
+    } else if ((formatTag == 1) && (bitsPerSample == 24)) {
+        m_format = SampleFormat::INT24;
+    } else if ((formatTag == 1) && (bitsPerSample == 32)) {
+        m_format = SampleFormat::INT32;
+    } else if ((formatTag == 3) && (bitsPerSample == 32)) {
+        m_format = SampleFormat::FLOAT32;
+    } else {
+        return false;
+    }
+    m_bytesPerSample = bitsPerSample / 8;
+    m_frameCount = dataSize / (m_bytesPerSample * m_channelCount);
+    return true;
+}
+
+
+float WavFileAudioSource::readSample(const uint8* src) const {
+    switch (m_format) {
+    case SampleFormat::INT16:
+        return (int16)readLE16(src) * (1.0f / 32768.0f);
+    case SampleFormat::INT24:
+        {
+            // Shift up to the top of an int32 so the sign extends, then back down
+            int32 value = (int32)(((uint32)src[0] << 8) | ((uint32)src[1] << 16) | ((uint32)src[2] << 24)) >> 8;
+            return value * (1.0f / 8388608.0f);
+        }
+    case SampleFormat::INT32:
+        return (int32)readLE32(src) * (1.0f / 2147483648.0f);
+    default:
+        {
+            float value;
+            memcpy(&value, src, sizeof(float));
+            return value;
+        }
+    }
+}
+
+
+bool WavFileAudioSource::readBlock(float* block) {
+    const size_t bytesPerFrame = m_bytesPerSample * m_channelCount;
+    const float channelScale = 1.0f / m_channelCount;
+
+    if ((m_position >= m_frameCount) && !m_loop) {
+        return false;
+    }
+
+    for (int i = 0; i < m_framesPerBlock; ++i) {
+        if (m_position >= m_frameCount) {
+            if (m_loop) {
+                m_position = 0;
+                m_prefetchedEnd = 0;
+                m_releasedEnd = 0;
+            } else {
+                // Pad the final, partial block with silence
+                memset(block + i * m_channelsPerFrame, 0, sizeof(float) * (m_framesPerBlock - i) * m_channelsPerFrame);
+                break;
+            }
+        }
+        const uint8* frame = m_file.data() + m_dataOffset + m_position * bytesPerFrame;
+        if (m_channelsPerFrame == 1) {
+            // Mix down to mono
+            float sum = 0.0f;
+            for (int c = 0; c < m_channelCount; ++c) {
+                sum += readSample(frame + c * m_bytesPerSample);
+            }
+            block[i] = sum * channelScale;
+        } else {
+            // Channel for channel; files with fewer channels than the queue wrap around (so mono fills every channel)
+            float* dst = block + i * m_channelsPerFrame;
+            for (int c = 0; c < m_channelsPerFrame; ++c) {
+                dst[c] = readSample(frame + (c % m_channelCount) * m_bytesPerSample);
+            }
+        }
+        ++m_position;
+    }
+
+    // Keep the OS reading ahead of us, and let go of what we're done with
+    const size_t consumed = m_position * bytesPerFrame;
+    if (consumed + READ_AHEAD_BYTES / 2 >= m_prefetchedEnd) {
+        m_file.prefetch(m_dataOffset + m_prefetchedEnd, READ_AHEAD_BYTES);
+        m_prefetchedEnd += READ_AHEAD_BYTES;
+    }
+    if (consumed >= m_releasedEnd + READ_AHEAD_BYTES) {
+        // Only whole pages go, so the next release picks up from the page the current frame is in
+        m_releasedEnd = m_file.release(m_dataOffset + m_releasedEnd, consumed - m_releasedEnd) - m_dataOffset;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+/**
+  \file WavFileAudioSource.h
+
+  Streams a WAV (or headerless PCM) file into the analysis pipeline.
+ */
+#ifndef WavFileAudioSource_h
+#define WavFileAudioSource_h
+
+#include <G3D/G3DAll.h>
+#include "AudioSource.h"
+#include "MemoryMappedFile.h"
+
+/**
+  AudioSource that reads a memory-mapped WAV file (16/24/32-bit integer or 32-bit float PCM, any number of channels,
+  mixed down to mono for a mono queue and mapped channel for channel otherwise) or a headerless file of 32-bit float samples. The file is never loaded as a whole: the mapping
+  is read sequentially, the OS is asked to read ahead of the current position, and pages behind it are released,
+  so arbitrarily long recordings stream in constant memory.
+ */
+class WavFileAudioSource : public AudioSource {
+public:
+    G3D_DECLARE_ENUM_CLASS(SampleFormat,
+        INT16,
+        INT24,
+        INT32,
+        FLOAT32);
+
+protected:
+    MemoryMappedFile    m_file;
+
+    /** Offset of the first sample in m_file */
+    size_t              m_dataOffset;
+    size_t              m_frameCount;
+
+    /** Channels in the file, which need not match m_channelsPerFrame */
+    int                 m_channelCount;
+    int                 m_sampleRate;
+    SampleFormat        m_format;
+    int                 m_bytesPerSample;
+
+    /** Next frame to read */
+    size_t              m_position;
+
+    /** Start over at the beginning instead of finishing at the end of the file */
+    bool                m_loop;
+
+    /** Bytes past the data offset up to which we have already asked the OS to read ahead */
+    size_t              m_prefetchedEnd;
+    /** Bytes past the data offset up to which we have already released consumed pages */
+    size_t              m_releasedEnd;
+
+    WavFileAudioSource();
+
+    /** Parse the RIFF header. Returns false if this isn't a WAV file we can play. */
+    bool parseWavHeader();
+
+    float readSample(const uint8* src) const;
+
+    virtual bool readBlock(float* block) override;
+
+public:
+
+    virtual ~WavFileAudioSource();
+
+    /** Open \a filename. Files ending in .wav are parsed as WAV; anything else is treated as headerless mono
+        32-bit float samples at \a rawSampleRate. Returns nullptr if the file can't be opened or isn't supported. */
+    static shared_ptr<WavFileAudioSource> create(const String& filename, bool loop = false, int rawSampleRate = 48000);
+
+    virtual int sampleRate() const override {
+        return m_sampleRate;
+    }
+
+    int channelCount() const {
+        return m_channelCount;
+    }
+
+    /** Length of the file in seconds */
+    RealTime duration() const {
+        return m_frameCount / (RealTime)m_sampleRate;
+    }
+};
+
+#endif
@@ -9,27 +9,44 @@
 //-----------------------------------------------------------------------------
 #include "chuck_fft.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 
 
 
 //-----------------------------------------------------------------------------
-// name: hanning()
-// desc: make window
+// name: fft_window_fill()
+// desc: fill length values of one of the FFT_WINDOW_* windows (periodic,
+//       so a length-N window is the first N points of a length-N+1 one).
+//       each point is computed straight from its index rather than by
+//       adding up a phase, so long windows don't drift
 //-----------------------------------------------------------------------------
-void hanning( float * window, unsigned long length )
+void fft_window_fill( float * window, unsigned long length, int type )
 {
     unsigned long i;
-    double pi, phase = 0, delta;
+    double pi, phase;
 
     pi = 4.*atan(1.0);
-    delta = 2 * pi / (double) length;
 
     for( i = 0; i < length; i++ )
     {
-        window[i] = (float)(0.5 * (1.0 - cos(phase)));
-        phase += delta;
+        phase = 2 * pi * (double) i / (double) length;
+        switch( type )
+        {
+        case FFT_WINDOW_HANNING:
+            window[i] = (float)(0.5 * (1.0 - cos(phase)));
+            break;
+        case FFT_WINDOW_HAMMING:
+            window[i] = (float)(0.54 - .46*cos(phase));
+            break;
+        case FFT_WINDOW_BLACKMAN:
+            window[i] = (float)(0.42 - .5*cos(phase) + .08*cos(2*phase));
+            break;
+        default:
+            window[i] = 1.f;
+            break;
+        }
     }
 }
 
@@ -37,22 +54,24 @@ void hanning( float * window, unsigned long length )
 
 
 //-----------------------------------------------------------------------------
-// name: hamming()
+// name: hanning()
 // desc: make window
 //-----------------------------------------------------------------------------
-void hamming( float * window, unsigned long length )
+void hanning( float * window, unsigned long length )
 {
-    unsigned long i;
-    double pi, phase = 0, delta;
+    fft_window_fill( window, length, FFT_WINDOW_HANNING );
+}
 
-    pi = 4.*atan(1.0);
-    delta = 2 * pi / (double) length;
 
-    for( i = 0; i < length; i++ )
-    {
-        window[i] = (float)(0.54 - .46*cos(phase));
-        phase += delta;
-    }
+
+
+//-----------------------------------------------------------------------------
+// name: hamming()
+// desc: make window
+//-----------------------------------------------------------------------------
+void hamming( float * window, unsigned long length )
+{
+    fft_window_fill( window, length, FFT_WINDOW_HAMMING );
 }
 
 
@@ -63,17 +82,7 @@ void hamming( float * window, unsigned long length )
 //-----------------------------------------------------------------------------
 void blackman( float * window, unsigned long length )
 {
-    unsigned long i;
-    double pi, phase = 0, delta;
-
-    pi = 4.*atan(1.0);
-    delta = 2 * pi / (double) length;
-
-    for( i = 0; i < length; i++ )
-    {
-        window[i] = (float)(0.42 - .5*cos(phase) + .08*cos(2*phase));
-        phase += delta;
-    }
+    fft_window_fill( window, length, FFT_WINDOW_BLACKMAN );
 }
 
 
@@ -91,8 +100,10 @@ void apply_window( float * data, float * window, unsigned long length )
         data[i] *= window[i];
 }
 
-static float PI ;
-static float TWOPI ;
+// no file-level state: these are constants, so any number of threads can
+// run every function in here at once
+#define FFT_PI    3.14159265358979323846
+#define FFT_TWOPI 6.28318530717958647693
 void bit_reverse( float * x, long N );
 
 //-----------------------------------------------------------------------------
@@ -114,19 +125,11 @@ void bit_reverse( float * x, long N );
 //-----------------------------------------------------------------------------
 void rfft( float * x, long N, unsigned int forward )
 {
-    static int first = 1 ;
     float c1, c2, h1r, h1i, h2r, h2i, wr, wi, wpr, wpi, temp, theta ;
     float xr, xi ;
     long i, i1, i2, i3, i4, N2p1 ;
 
-    if( first )
-    {
-        PI = (float) (4.*atan( 1. )) ;
-        TWOPI = (float) (8.*atan( 1. )) ;
-        first = 0 ;
-    }
-
-    theta = PI/N ;
+    theta = (float)(FFT_PI/N) ;
     wr = 1. ;
     wi = 0. ;
     c1 = 0.5 ;
@@ -219,7 +222,7 @@ void cfft( float * x, long NC, unsigned int forward )
     for( mmax = 2 ; mmax < ND ; mmax = delta )
     {
         delta = mmax<<1 ;
-        theta = TWOPI/( forward? mmax : -mmax ) ;
+        theta = (float)(FFT_TWOPI/( forward? mmax : -mmax )) ;
         wpr = (float) (-2.*pow( sin( 0.5*theta ), 2. )) ;
         wpi = (float) sin( theta ) ;
         wr = 1. ;
@@ -278,3 +281,1488 @@ void bit_reverse( float * x, long N )
             j -= m ;
     }
 }
+
+
+
+
+//-----------------------------------------------------------------------------
+// SIMD support: which instruction sets we can compile for here; which ones
+// the CPU actually has is checked when a plan is created
+//-----------------------------------------------------------------------------
+#if defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 )
+  #define FFT_X86
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    // MSVC compiles intrinsics for any instruction set without flags
+    #define FFT_TARGET_AVX2
+  #else
+    #include <cpuid.h>
+    // gcc/clang only allow AVX intrinsics in functions compiled for AVX
+    #define FFT_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+  #endif
+#endif
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ ) || defined( _M_ARM64 )
+  #define FFT_NEON
+  #include <arm_neon.h>
+#endif
+
+
+// one radix-4 stage: combines groups of four length-h transforms (see
+// fft_radix4_stage_scalar) in the 2*NC floats of x
+typedef void (* fft_stage_function)( float * x, long NC, long h, const float * tw, const float * jsign ) ;
+
+// one radix-4 stockham stage: reads NC complex values from x and writes
+// them to y, turning transforms of n points into transforms of n/4 points
+// (see fft_stockham4_stage_scalar). win is NULL, or 2*NC floats to multiply
+// x by as it's read; only the first stage (where x is the caller's input)
+// gets one, which is how windowing costs no pass of its own
+typedef void (* fft_stockham_function)( const float * x, const float * win, float * y, long NC, long n, const float * tw, const float * jsign ) ;
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: struct fft_plan
+// desc: everything cfft/rfft compute on the fly, computed once (in double
+//       precision) for one size
+//-----------------------------------------------------------------------------
+struct fft_plan
+{
+    // number of complex points
+    long NC ;
+    // instruction set the stages were picked for (FFT_SIMD_*)
+    int simd ;
+    // true when NC is a power of 2. otherwise NC is a product of 2s, 3s
+    // and 5s, and only the stockham stages exist
+    int power_of_2 ;
+    // true when NC has an odd number of factors of 2, so a radix-2 stage
+    // runs before the other stages (and last in cfft_stockham())
+    int radix2_first ;
+    // the radix-3, radix-5 and then radix-4 stages, smallest transforms
+    // first; stage s combines stage_radix[s] transforms of stage_h[s]
+    // points, using (radix-1)*4*stage_h[s] floats of twiddles starting at
+    // stage_offset[s]. power of 2 plans do that in place with
+    // stage_function[s]. cfft_stockham() runs the stages in the opposite
+    // order, splitting transforms of radix*stage_h[s] points with
+    // stockham_function[s] and the same twiddles
+    long stage_count ;
+    long stage_radix[32] ;
+    long stage_h[32] ;
+    long stage_offset[32] ;
+    fft_stage_function stage_function[32] ;
+    fft_stockham_function stockham_function[32] ;
+    // twiddles for every stage, forward and inverse (see
+    // fft_stage_twiddles for the layout)
+    float * twiddles ;
+    float * inverse_twiddles ;
+    // rfft pre/post-processing twiddles exp( i*pi*k/NC ), k = 0 .. NC/2
+    complex * real_twiddles ;
+    // 2*NC-point tables of each FFT_WINDOW_* window (NULL for none), so
+    // windowing a frame never computes a cos
+    float * windows[FFT_WINDOW_COUNT] ;
+    // complex indices to exchange for the bit-reversal permutation,
+    // as (i, j) pairs with i < j
+    long * swaps ;
+    long swap_count ;
+} ;
+
+// multiplying by i (forward) or -i (inverse) swaps re and im and flips
+// one sign; these are the signs, for two complex values
+static const float fft_forward_jsign[4] = { -1.f, 1.f, -1.f, 1.f } ;
+static const float fft_inverse_jsign[4] = { 1.f, -1.f, 1.f, -1.f } ;
+
+static void fft_stockham_run( const fft_plan * plan, const float * in, const float * window,
+                              float * out, float * work, unsigned int forward ) ;
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stage_twiddles()
+// desc: fill the (radix-1)*4*h floats of twiddles for the stage that
+//       combines radix transforms of h points (into transforms of
+//       n = radix*h points). for each of w^k, w^2k, ... w^((radix-1)k)
+//       (w = exp( +-2*pi*i/n )) there are 2h floats of real parts, each
+//       repeated twice, then 2h floats of imaginary parts as (-im, im), so
+//       that x*w = x*re + swap(x)*im for interleaved complex x, two or four
+//       at a time. the in-place and the stockham stages share these tables
+//-----------------------------------------------------------------------------
+static void fft_stage_twiddles( float * tw, long h, long radix, double sign )
+{
+    long k, q ;
+    for( q = 0 ; q < radix - 1 ; q++ )
+    {
+        float * re = tw + q * 4 * h ;
+        float * im = re + 2 * h ;
+        for( k = 0 ; k < h ; k++ )
+        {
+            double angle = sign * FFT_TWOPI * (q + 1) * k / ( (double)radix * h ) ;
+            re[2*k] = re[2*k + 1] = (float)cos( angle ) ;
+            im[2*k] = (float)-sin( angle ) ;
+            im[2*k + 1] = (float)sin( angle ) ;
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_radix4_stage_scalar()
+// desc: portable radix-4 stage. x holds (in bit-reversed order) groups of
+//       four length-h transforms E0, E2, E1, E3 of the samples = 0, 2, 1,
+//       3 mod 4; each group becomes one length-4h transform:
+//         Y[k + qh] = sum over r of (j^q)^r * w^(rk) * E_r[k]
+//       with j = w^h = i (forward) or -i (inverse)
+//-----------------------------------------------------------------------------
+static void fft_radix4_stage_scalar( float * x, long NC, long h, const float * tw, const float * jsign )
+{
+    const float * twb = tw + 4 * h ;
+    const float * twc = tw ;
+    const float * twd = tw + 8 * h ;
+    float ar, ai, br, bi, cr, ci, dr, di, tr, ti ;
+    float s02r, s02i, d02r, d02i, s13r, s13i, d13r, d13i ;
+    long group, k ;
+    float * a ;
+
+    for( group = 0 ; group < NC<<1 ; group += h<<3 )
+    {
+        for( k = 0 ; k < h ; k++ )
+        {
+            a = x + group + (k<<1) ;
+            ar = a[0] ; ai = a[1] ;
+            // b, c and d times their twiddles
+            tr = a[2*h] ; ti = a[2*h + 1] ;
+            br = tr*twb[2*k] + ti*twb[2*h + 2*k] ;
+            bi = ti*twb[2*k] + tr*twb[2*h + 2*k + 1] ;
+            tr = a[4*h] ; ti = a[4*h + 1] ;
+            cr = tr*twc[2*k] + ti*twc[2*h + 2*k] ;
+            ci = ti*twc[2*k] + tr*twc[2*h + 2*k + 1] ;
+            tr = a[6*h] ; ti = a[6*h + 1] ;
+            dr = tr*twd[2*k] + ti*twd[2*h + 2*k] ;
+            di = ti*twd[2*k] + tr*twd[2*h + 2*k + 1] ;
+
+            s02r = ar + br ; s02i = ai + bi ;
+            d02r = ar - br ; d02i = ai - bi ;
+            s13r = cr + dr ; s13i = ci + di ;
+            // j * (c - d)
+            d13r = (ci - di) * jsign[0] ;
+            d13i = (cr - dr) * jsign[1] ;
+
+            a[0]       = s02r + s13r ; a[1]       = s02i + s13i ;
+            a[2*h]     = d02r + d13r ; a[2*h + 1] = d02i + d13i ;
+            a[4*h]     = s02r - s13r ; a[4*h + 1] = s02i - s13i ;
+            a[6*h]     = d02r - d13r ; a[6*h + 1] = d02i - d13i ;
+        }
+    }
+}
+
+
+
+
+#ifdef FFT_X86
+//-----------------------------------------------------------------------------
+// name: fft_radix4_stage_sse2()
+// desc: fft_radix4_stage_scalar() two complex values at a time; h >= 2
+//-----------------------------------------------------------------------------
+static void fft_radix4_stage_sse2( float * x, long NC, long h, const float * tw, const float * jsign )
+{
+    const float * twb = tw + 4 * h ;
+    const float * twc = tw ;
+    const float * twd = tw + 8 * h ;
+    const __m128 j = _mm_loadu_ps( jsign ) ;
+    long group, k ;
+
+    for( group = 0 ; group < NC<<1 ; group += h<<3 )
+    {
+        for( k = 0 ; k < h ; k += 2 )
+        {
+            float * p = x + group + (k<<1) ;
+            __m128 a = _mm_loadu_ps( p ) ;
+            __m128 b = _mm_loadu_ps( p + 2*h ) ;
+            __m128 c = _mm_loadu_ps( p + 4*h ) ;
+            __m128 d = _mm_loadu_ps( p + 6*h ) ;
+            __m128 s02, d02, s13, d13 ;
+
+            // x*w = x*re + swap(x)*im
+            b = _mm_add_ps( _mm_mul_ps( b, _mm_loadu_ps( twb + 2*k ) ),
+                            _mm_mul_ps( _mm_shuffle_ps( b, b, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _mm_loadu_ps( twb + 2*h + 2*k ) ) ) ;
+            c = _mm_add_ps( _mm_mul_ps( c, _mm_loadu_ps( twc + 2*k ) ),
+                            _mm_mul_ps( _mm_shuffle_ps( c, c, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _mm_loadu_ps( twc + 2*h + 2*k ) ) ) ;
+            d = _mm_add_ps( _mm_mul_ps( d, _mm_loadu_ps( twd + 2*k ) ),
+                            _mm_mul_ps( _mm_shuffle_ps( d, d, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _mm_loadu_ps( twd + 2*h + 2*k ) ) ) ;
+
+            s02 = _mm_add_ps( a, b ) ;
+            d02 = _mm_sub_ps( a, b ) ;
+            s13 = _mm_add_ps( c, d ) ;
+            d13 = _mm_sub_ps( c, d ) ;
+            d13 = _mm_mul_ps( _mm_shuffle_ps( d13, d13, _MM_SHUFFLE( 2, 3, 0, 1 ) ), j ) ;
+
+            _mm_storeu_ps( p,         _mm_add_ps( s02, s13 ) ) ;
+            _mm_storeu_ps( p + 2*h,   _mm_add_ps( d02, d13 ) ) ;
+            _mm_storeu_ps( p + 4*h,   _mm_sub_ps( s02, s13 ) ) ;
+            _mm_storeu_ps( p + 6*h,   _mm_sub_ps( d02, d13 ) ) ;
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_radix4_stage_avx2()
+// desc: fft_radix4_stage_scalar() four complex values at a time; h >= 4
+//-----------------------------------------------------------------------------
+FFT_TARGET_AVX2
+static void fft_radix4_stage_avx2( float * x, long NC, long h, const float * tw, const float * jsign )
+{
+    const float * twb = tw + 4 * h ;
+    const float * twc = tw ;
+    const float * twd = tw + 8 * h ;
+    const __m256 j = _mm256_setr_ps( jsign[0], jsign[1], jsign[0], jsign[1], jsign[0], jsign[1], jsign[0], jsign[1] ) ;
+    long group, k ;
+
+    for( group = 0 ; group < NC<<1 ; group += h<<3 )
+    {
+        for( k = 0 ; k < h ; k += 4 )
+        {
+            float * p = x + group + (k<<1) ;
+            __m256 a = _mm256_loadu_ps( p ) ;
+            __m256 b = _mm256_loadu_ps( p + 2*h ) ;
+            __m256 c = _mm256_loadu_ps( p + 4*h ) ;
+            __m256 d = _mm256_loadu_ps( p + 6*h ) ;
+            __m256 s02, d02, s13, d13 ;
+
+            b = _mm256_add_ps( _mm256_mul_ps( b, _mm256_loadu_ps( twb + 2*k ) ),
+                               _mm256_mul_ps( _mm256_permute_ps( b, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _mm256_loadu_ps( twb + 2*h + 2*k ) ) ) ;
+            c = _mm256_add_ps( _mm256_mul_ps( c, _mm256_loadu_ps( twc + 2*k ) ),
+                               _mm256_mul_ps( _mm256_permute_ps( c, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _mm256_loadu_ps( twc + 2*h + 2*k ) ) ) ;
+            d = _mm256_add_ps( _mm256_mul_ps( d, _mm256_loadu_ps( twd + 2*k ) ),
+                               _mm256_mul_ps( _mm256_permute_ps( d, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _mm256_loadu_ps( twd + 2*h + 2*k ) ) ) ;
+
+            s02 = _mm256_add_ps( a, b ) ;
+            d02 = _mm256_sub_ps( a, b ) ;
+            s13 = _mm256_add_ps( c, d ) ;
+            d13 = _mm256_sub_ps( c, d ) ;
+            d13 = _mm256_mul_ps( _mm256_permute_ps( d13, _MM_SHUFFLE( 2, 3, 0, 1 ) ), j ) ;
+
+            _mm256_storeu_ps( p,         _mm256_add_ps( s02, s13 ) ) ;
+            _mm256_storeu_ps( p + 2*h,   _mm256_add_ps( d02, d13 ) ) ;
+            _mm256_storeu_ps( p + 4*h,   _mm256_sub_ps( s02, s13 ) ) ;
+            _mm256_storeu_ps( p + 6*h,   _mm256_sub_ps( d02, d13 ) ) ;
+        }
+    }
+}
+#endif
+
+
+
+
+#ifdef FFT_NEON
+//-----------------------------------------------------------------------------
+// name: fft_radix4_stage_neon()
+// desc: fft_radix4_stage_scalar() two complex values at a time; h >= 2
+//-----------------------------------------------------------------------------
+static void fft_radix4_stage_neon( float * x, long NC, long h, const float * tw, const float * jsign )
+{
+    const float * twb = tw + 4 * h ;
+    const float * twc = tw ;
+    const float * twd = tw + 8 * h ;
+    const float32x4_t j = vld1q_f32( jsign ) ;
+    long group, k ;
+
+    for( group = 0 ; group < NC<<1 ; group += h<<3 )
+    {
+        for( k = 0 ; k < h ; k += 2 )
+        {
+            float * p = x + group + (k<<1) ;
+            float32x4_t a = vld1q_f32( p ) ;
+            float32x4_t b = vld1q_f32( p + 2*h ) ;
+            float32x4_t c = vld1q_f32( p + 4*h ) ;
+            float32x4_t d = vld1q_f32( p + 6*h ) ;
+            float32x4_t s02, d02, s13, d13 ;
+
+            // vrev64q_f32 swaps re and im of each complex value
+            b = vmlaq_f32( vmulq_f32( b, vld1q_f32( twb + 2*k ) ), vrev64q_f32( b ), vld1q_f32( twb + 2*h + 2*k ) ) ;
+            c = vmlaq_f32( vmulq_f32( c, vld1q_f32( twc + 2*k ) ), vrev64q_f32( c ), vld1q_f32( twc + 2*h + 2*k ) ) ;
+            d = vmlaq_f32( vmulq_f32( d, vld1q_f32( twd + 2*k ) ), vrev64q_f32( d ), vld1q_f32( twd + 2*h + 2*k ) ) ;
+
+            s02 = vaddq_f32( a, b ) ;
+            d02 = vsubq_f32( a, b ) ;
+            s13 = vaddq_f32( c, d ) ;
+            d13 = vmulq_f32( vrev64q_f32( vsubq_f32( c, d ) ), j ) ;
+
+            vst1q_f32( p,         vaddq_f32( s02, s13 ) ) ;
+            vst1q_f32( p + 2*h,   vaddq_f32( d02, d13 ) ) ;
+            vst1q_f32( p + 4*h,   vsubq_f32( s02, s13 ) ) ;
+            vst1q_f32( p + 6*h,   vsubq_f32( d02, d13 ) ) ;
+        }
+    }
+}
+#endif
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stockham4_stage_scalar()
+// desc: portable radix-4 stockham (self-sorting) stage. x holds s = NC/n
+//       interleaved length-n transforms to split: value p of transform q
+//       is x[q + s*p]. with the quarters a, b, c, d = x[q + s*(p + m*n/4)]
+//       and w = exp( +-2*pi*i/n ), p < n/4,
+//         y[q + s*(4p + r)] = w^(rp) * sum over m of (j^r)^m * quarter m
+//       which leaves 4s interleaved length-n/4 transforms in y, so after
+//       the last stage y is in natural order and no permutation is needed
+//-----------------------------------------------------------------------------
+static void fft_stockham4_stage_scalar( const float * x, const float * win, float * y, long NC, long n, const float * tw, const float * jsign )
+{
+    const long h = n >> 2 ;
+    const long s = NC / n ;
+    const float * tw1 = tw ;
+    const float * tw2 = tw + 4 * h ;
+    const float * tw3 = tw + 8 * h ;
+    float ar, ai, br, bi, cr, ci, dr, di ;
+    float apcr, apci, amcr, amci, bpdr, bpdi, jbmdr, jbmdi, tr, ti ;
+    long p, q ;
+    const float * a ;
+    const float * wa ;
+    float * out ;
+
+    for( p = 0 ; p < h ; p++ )
+    {
+        for( q = 0 ; q < s ; q++ )
+        {
+            a = x + ( ( q + s*p ) << 1 ) ;
+            out = y + ( ( q + 4*s*p ) << 1 ) ;
+
+            ar = a[0] ; ai = a[1] ;
+            br = a[2*s*h] ; bi = a[2*s*h + 1] ;
+            cr = a[4*s*h] ; ci = a[4*s*h + 1] ;
+            dr = a[6*s*h] ; di = a[6*s*h + 1] ;
+            if( win )
+            {
+                wa = win + ( ( q + s*p ) << 1 ) ;
+                ar *= wa[0] ; ai *= wa[1] ;
+                br *= wa[2*s*h] ; bi *= wa[2*s*h + 1] ;
+                cr *= wa[4*s*h] ; ci *= wa[4*s*h + 1] ;
+                dr *= wa[6*s*h] ; di *= wa[6*s*h + 1] ;
+            }
+
+            apcr = ar + cr ; apci = ai + ci ;
+            amcr = ar - cr ; amci = ai - ci ;
+            bpdr = br + dr ; bpdi = bi + di ;
+            // j * (b - d)
+            jbmdr = ( bi - di ) * jsign[0] ;
+            jbmdi = ( br - dr ) * jsign[1] ;
+
+            out[0] = apcr + bpdr ; out[1] = apci + bpdi ;
+            tr = amcr + jbmdr ; ti = amci + jbmdi ;
+            out[2*s]     = tr*tw1[2*p] + ti*tw1[2*h + 2*p] ;
+            out[2*s + 1] = ti*tw1[2*p] + tr*tw1[2*h + 2*p + 1] ;
+            tr = apcr - bpdr ; ti = apci - bpdi ;
+            out[4*s]     = tr*tw2[2*p] + ti*tw2[2*h + 2*p] ;
+            out[4*s + 1] = ti*tw2[2*p] + tr*tw2[2*h + 2*p + 1] ;
+            tr = amcr - jbmdr ; ti = amci - jbmdi ;
+            out[6*s]     = tr*tw3[2*p] + ti*tw3[2*h + 2*p] ;
+            out[6*s + 1] = ti*tw3[2*p] + tr*tw3[2*h + 2*p + 1] ;
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stockham2_stage()
+// desc: the last stage when log2( NC ) is odd: splits s = NC/2 interleaved
+//       length-2 transforms, which needs no twiddles (and, with win,
+//       the first one too when NC is 2)
+//-----------------------------------------------------------------------------
+static void fft_stockham2_stage( const float * x, const float * win, float * y, long NC )
+{
+    const long s = NC >> 1 ;
+    long q ;
+    float a, b ;
+
+    for( q = 0 ; q < s<<1 ; q++ )
+    {
+        a = x[q] ; b = x[q + 2*s] ;
+        if( win )
+        {
+            a *= win[q] ; b *= win[q + 2*s] ;
+        }
+        y[q] = a + b ;
+        y[q + 2*s] = a - b ;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stockham3_stage_scalar()
+// desc: fft_stockham4_stage_scalar() for radix 3: the thirds a, b, c
+//       become y[q + s*(3p + r)] = w^(rp) * sum over m of W^(rm) * third m
+//       with W = exp( +-2*pi*i/3 ) = -1/2 + j*sqrt(3)/2
+//-----------------------------------------------------------------------------
+static void fft_stockham3_stage_scalar( const float * x, const float * win, float * y, long NC, long n, const float * tw, const float * jsign )
+{
+    const long h = n / 3 ;
+    const long s = NC / n ;
+    const float * tw1 = tw ;
+    const float * tw2 = tw + 4 * h ;
+    const float sin60 = 0.86602540378443865f ;
+    float ar, ai, br, bi, cr, ci ;
+    float t1r, t1i, t2r, t2i, t3r, t3i, tr, ti ;
+    long p, q ;
+    const float * a ;
+    const float * wa ;
+    float * out ;
+
+    for( p = 0 ; p < h ; p++ )
+    {
+        for( q = 0 ; q < s ; q++ )
+        {
+            a = x + ( ( q + s*p ) << 1 ) ;
+            out = y + ( ( q + 3*s*p ) << 1 ) ;
+
+            ar = a[0] ; ai = a[1] ;
+            br = a[2*s*h] ; bi = a[2*s*h + 1] ;
+            cr = a[4*s*h] ; ci = a[4*s*h + 1] ;
+            if( win )
+            {
+                wa = win + ( ( q + s*p ) << 1 ) ;
+                ar *= wa[0] ; ai *= wa[1] ;
+                br *= wa[2*s*h] ; bi *= wa[2*s*h + 1] ;
+                cr *= wa[4*s*h] ; ci *= wa[4*s*h + 1] ;
+            }
+
+            t1r = br + cr ; t1i = bi + ci ;
+            t2r = ar - 0.5f * t1r ; t2i = ai - 0.5f * t1i ;
+            // j * sqrt(3)/2 * (b - c)
+            t3r = ( bi - ci ) * jsign[0] * sin60 ;
+            t3i = ( br - cr ) * jsign[1] * sin60 ;
+
+            out[0] = ar + t1r ; out[1] = ai + t1i ;
+            tr = t2r + t3r ; ti = t2i + t3i ;
+            out[2*s]     = tr*tw1[2*p] + ti*tw1[2*h + 2*p] ;
+            out[2*s + 1] = ti*tw1[2*p] + tr*tw1[2*h + 2*p + 1] ;
+            tr = t2r - t3r ; ti = t2i - t3i ;
+            out[4*s]     = tr*tw2[2*p] + ti*tw2[2*h + 2*p] ;
+            out[4*s + 1] = ti*tw2[2*p] + tr*tw2[2*h + 2*p + 1] ;
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stockham5_stage_scalar()
+// desc: fft_stockham4_stage_scalar() for radix 5, with the fifths a .. e
+//       and W = exp( +-2*pi*i/5 )
+//-----------------------------------------------------------------------------
+static void fft_stockham5_stage_scalar( const float * x, const float * win, float * y, long NC, long n, const float * tw, const float * jsign )
+{
+    const long h = n / 5 ;
+    const long s = NC / n ;
+    // re and im of W and W^2
+    const float c1 = 0.30901699437494742f, c2 = -0.80901699437494742f ;
+    const float s1 = 0.95105651629515357f, s2 = 0.58778525229247313f ;
+    float ar, ai, br, bi, cr, ci, dr, di, er, ei ;
+    float bper, bpei, bmer, bmei, cpdr, cpdi, cmdr, cmdi ;
+    float u1r, u1i, u2r, u2i, v1r, v1i, v2r, v2i, tr, ti ;
+    float yr[4], yi[4] ;
+    long p, q, r ;
+    const float * a ;
+    const float * wa ;
+    const float * w ;
+    float * out ;
+
+    for( p = 0 ; p < h ; p++ )
+    {
+        for( q = 0 ; q < s ; q++ )
+        {
+            a = x + ( ( q + s*p ) << 1 ) ;
+            out = y + ( ( q + 5*s*p ) << 1 ) ;
+
+            ar = a[0] ; ai = a[1] ;
+            br = a[2*s*h] ; bi = a[2*s*h + 1] ;
+            cr = a[4*s*h] ; ci = a[4*s*h + 1] ;
+            dr = a[6*s*h] ; di = a[6*s*h + 1] ;
+            er = a[8*s*h] ; ei = a[8*s*h + 1] ;
+            if( win )
+            {
+                wa = win + ( ( q + s*p ) << 1 ) ;
+                ar *= wa[0] ; ai *= wa[1] ;
+                br *= wa[2*s*h] ; bi *= wa[2*s*h + 1] ;
+                cr *= wa[4*s*h] ; ci *= wa[4*s*h + 1] ;
+                dr *= wa[6*s*h] ; di *= wa[6*s*h + 1] ;
+                er *= wa[8*s*h] ; ei *= wa[8*s*h + 1] ;
+            }
+
+            bper = br + er ; bpei = bi + ei ;
+            bmer = br - er ; bmei = bi - ei ;
+            cpdr = cr + dr ; cpdi = ci + di ;
+            cmdr = cr - dr ; cmdi = ci - di ;
+
+            u1r = ar + c1*bper + c2*cpdr ; u1i = ai + c1*bpei + c2*cpdi ;
+            u2r = ar + c2*bper + c1*cpdr ; u2i = ai + c2*bpei + c1*cpdi ;
+            // j * (s1*(b - e) + s2*(c - d)) and j * (s2*(b - e) - s1*(c - d))
+            v1r = ( s1*bmei + s2*cmdi ) * jsign[0] ; v1i = ( s1*bmer + s2*cmdr ) * jsign[1] ;
+            v2r = ( s2*bmei - s1*cmdi ) * jsign[0] ; v2i = ( s2*bmer - s1*cmdr ) * jsign[1] ;
+
+            out[0] = ar + bper + cpdr ; out[1] = ai + bpei + cpdi ;
+            yr[0] = u1r + v1r ; yi[0] = u1i + v1i ;
+            yr[1] = u2r + v2r ; yi[1] = u2i + v2i ;
+            yr[2] = u2r - v2r ; yi[2] = u2i - v2i ;
+            yr[3] = u1r - v1r ; yi[3] = u1i - v1i ;
+            for( r = 0 ; r < 4 ; r++ )
+            {
+                w = tw + r * 4 * h ;
+                tr = yr[r] ; ti = yi[r] ;
+                out[2*s*(r + 1)]     = tr*w[2*p] + ti*w[2*h + 2*p] ;
+                out[2*s*(r + 1) + 1] = ti*w[2*p] + tr*w[2*h + 2*p + 1] ;
+            }
+        }
+    }
+}
+
+
+
+
+#ifdef FFT_X86
+//-----------------------------------------------------------------------------
+// name: fft_stockham4_stage_sse2()
+// desc: fft_stockham4_stage_scalar() two complex values at a time: two
+//       transforms (q) per step, or for the first stage (s = 1, n >= 8)
+//       two values (p), which then have to be interleaved on the way out
+//-----------------------------------------------------------------------------
+static void fft_stockham4_stage_sse2( const float * x, const float * win, float * y, long NC, long n, const float * tw, const float * jsign )
+{
+    const long h = n >> 2 ;
+    const long s = NC / n ;
+    const float * tw1 = tw ;
+    const float * tw2 = tw + 4 * h ;
+    const float * tw3 = tw + 8 * h ;
+    const __m128 j = _mm_loadu_ps( jsign ) ;
+    __m128 w1r, w1i, w2r, w2i, w3r, w3i ;
+    __m128 a, b, c, d, apc, amc, bpd, jbmd, y0, y1, y2, y3 ;
+    long p, q ;
+
+    for( p = 0 ; p < h ; p += ( s == 1 ? 2 : 1 ) )
+    {
+        if( s == 1 )
+        {
+            w1r = _mm_loadu_ps( tw1 + 2*p ) ; w1i = _mm_loadu_ps( tw1 + 2*h + 2*p ) ;
+            w2r = _mm_loadu_ps( tw2 + 2*p ) ; w2i = _mm_loadu_ps( tw2 + 2*h + 2*p ) ;
+            w3r = _mm_loadu_ps( tw3 + 2*p ) ; w3i = _mm_loadu_ps( tw3 + 2*h + 2*p ) ;
+        }
+        else
+        {
+            // one twiddle for every transform
+            w1r = _mm_set1_ps( tw1[2*p] ) ;
+            w1i = _mm_setr_ps( tw1[2*h + 2*p], tw1[2*h + 2*p + 1], tw1[2*h + 2*p], tw1[2*h + 2*p + 1] ) ;
+            w2r = _mm_set1_ps( tw2[2*p] ) ;
+            w2i = _mm_setr_ps( tw2[2*h + 2*p], tw2[2*h + 2*p + 1], tw2[2*h + 2*p], tw2[2*h + 2*p + 1] ) ;
+            w3r = _mm_set1_ps( tw3[2*p] ) ;
+            w3i = _mm_setr_ps( tw3[2*h + 2*p], tw3[2*h + 2*p + 1], tw3[2*h + 2*p], tw3[2*h + 2*p + 1] ) ;
+        }
+
+        for( q = 0 ; q < s || q == 0 ; q += 2 )
+        {
+            const float * in = x + ( ( q + s*p ) << 1 ) ;
+            float * out = y + ( ( q + 4*s*p ) << 1 ) ;
+
+            a = _mm_loadu_ps( in ) ;
+            b = _mm_loadu_ps( in + 2*s*h ) ;
+            c = _mm_loadu_ps( in + 4*s*h ) ;
+            d = _mm_loadu_ps( in + 6*s*h ) ;
+            if( win )
+            {
+                const float * wa = win + ( ( q + s*p ) << 1 ) ;
+                a = _mm_mul_ps( a, _mm_loadu_ps( wa ) ) ;
+                b = _mm_mul_ps( b, _mm_loadu_ps( wa + 2*s*h ) ) ;
+                c = _mm_mul_ps( c, _mm_loadu_ps( wa + 4*s*h ) ) ;
+                d = _mm_mul_ps( d, _mm_loadu_ps( wa + 6*s*h ) ) ;
+            }
+
+            apc = _mm_add_ps( a, c ) ;
+            amc = _mm_sub_ps( a, c ) ;
+            bpd = _mm_add_ps( b, d ) ;
+            jbmd = _mm_sub_ps( b, d ) ;
+            jbmd = _mm_mul_ps( _mm_shuffle_ps( jbmd, jbmd, _MM_SHUFFLE( 2, 3, 0, 1 ) ), j ) ;
+
+            y0 = _mm_add_ps( apc, bpd ) ;
+            y1 = _mm_add_ps( amc, jbmd ) ;
+            y2 = _mm_sub_ps( apc, bpd ) ;
+            y3 = _mm_sub_ps( amc, jbmd ) ;
+            // y*w = y*re + swap(y)*im
+            y1 = _mm_add_ps( _mm_mul_ps( y1, w1r ), _mm_mul_ps( _mm_shuffle_ps( y1, y1, _MM_SHUFFLE( 2, 3, 0, 1 ) ), w1i ) ) ;
+            y2 = _mm_add_ps( _mm_mul_ps( y2, w2r ), _mm_mul_ps( _mm_shuffle_ps( y2, y2, _MM_SHUFFLE( 2, 3, 0, 1 ) ), w2i ) ) ;
+            y3 = _mm_add_ps( _mm_mul_ps( y3, w3r ), _mm_mul_ps( _mm_shuffle_ps( y3, y3, _MM_SHUFFLE( 2, 3, 0, 1 ) ), w3i ) ) ;
+
+            if( s == 1 )
+            {
+                // (y0 y1 y2 y3) of p, then of p + 1
+                _mm_storeu_ps( out,      _mm_movelh_ps( y0, y1 ) ) ;
+                _mm_storeu_ps( out + 4,  _mm_movelh_ps( y2, y3 ) ) ;
+                _mm_storeu_ps( out + 8,  _mm_movehl_ps( y1, y0 ) ) ;
+                _mm_storeu_ps( out + 12, _mm_movehl_ps( y3, y2 ) ) ;
+            }
+            else
+            {
+                _mm_storeu_ps( out,       y0 ) ;
+                _mm_storeu_ps( out + 2*s, y1 ) ;
+                _mm_storeu_ps( out + 4*s, y2 ) ;
+                _mm_storeu_ps( out + 6*s, y3 ) ;
+            }
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stockham4_stage_avx2()
+// desc: fft_stockham4_stage_scalar() four transforms at a time; s >= 4
+//-----------------------------------------------------------------------------
+FFT_TARGET_AVX2
+static void fft_stockham4_stage_avx2( const float * x, const float * win, float * y, long NC, long n, const float * tw, const float * jsign )
+{
+    const long h = n >> 2 ;
+    const long s = NC / n ;
+    const float * tw1 = tw ;
+    const float * tw2 = tw + 4 * h ;
+    const float * tw3 = tw + 8 * h ;
+    const __m256 j = _mm256_setr_ps( jsign[0], jsign[1], jsign[0], jsign[1], jsign[0], jsign[1], jsign[0], jsign[1] ) ;
+    __m256 w1r, w1i, w2r, w2i, w3r, w3i ;
+    __m256 a, b, c, d, apc, amc, bpd, jbmd, y0, y1, y2, y3 ;
+    long p, q ;
+
+    for( p = 0 ; p < h ; p++ )
+    {
+        w1r = _mm256_set1_ps( tw1[2*p] ) ;
+        w1i = _mm256_setr_ps( tw1[2*h + 2*p], tw1[2*h + 2*p + 1], tw1[2*h + 2*p], tw1[2*h + 2*p + 1],
+                              tw1[2*h + 2*p], tw1[2*h + 2*p + 1], tw1[2*h + 2*p], tw1[2*h + 2*p + 1] ) ;
+        w2r = _mm256_set1_ps( tw2[2*p] ) ;
+        w2i = _mm256_setr_ps( tw2[2*h + 2*p], tw2[2*h + 2*p + 1], tw2[2*h + 2*p], tw2[2*h + 2*p + 1],
+                              tw2[2*h + 2*p], tw2[2*h + 2*p + 1], tw2[2*h + 2*p], tw2[2*h + 2*p + 1] ) ;
+        w3r = _mm256_set1_ps( tw3[2*p] ) ;
+        w3i = _mm256_setr_ps( tw3[2*h + 2*p], tw3[2*h + 2*p + 1], tw3[2*h + 2*p], tw3[2*h + 2*p + 1],
+                              tw3[2*h + 2*p], tw3[2*h + 2*p + 1], tw3[2*h + 2*p], tw3[2*h + 2*p + 1] ) ;
+
+        for( q = 0 ; q < s ; q += 4 )
+        {
+            const float * in = x + ( ( q + s*p ) << 1 ) ;
+            float * out = y + ( ( q + 4*s*p ) << 1 ) ;
+
+            a = _mm256_loadu_ps( in ) ;
+            b = _mm256_loadu_ps( in + 2*s*h ) ;
+            c = _mm256_loadu_ps( in + 4*s*h ) ;
+            d = _mm256_loadu_ps( in + 6*s*h ) ;
+            if( win )
+            {
+                const float * wa = win + ( ( q + s*p ) << 1 ) ;
+                a = _mm256_mul_ps( a, _mm256_loadu_ps( wa ) ) ;
+                b = _mm256_mul_ps( b, _mm256_loadu_ps( wa + 2*s*h ) ) ;
+                c = _mm256_mul_ps( c, _mm256_loadu_ps( wa + 4*s*h ) ) ;
+                d = _mm256_mul_ps( d, _mm256_loadu_ps( wa + 6*s*h ) ) ;
+            }
+
+            apc = _mm256_add_ps( a, c ) ;
+            amc = _mm256_sub_ps( a, c ) ;
+            bpd = _mm256_add_ps( b, d ) ;
+            jbmd = _mm256_sub_ps( b, d ) ;
+            jbmd = _mm256_mul_ps( _mm256_permute_ps( jbmd, _MM_SHUFFLE( 2, 3, 0, 1 ) ), j ) ;
+
+            y0 = _mm256_add_ps( apc, bpd ) ;
+            y1 = _mm256_add_ps( amc, jbmd ) ;
+            y2 = _mm256_sub_ps( apc, bpd ) ;
+            y3 = _mm256_sub_ps( amc, jbmd ) ;
+            y1 = _mm256_add_ps( _mm256_mul_ps( y1, w1r ), _mm256_mul_ps( _mm256_permute_ps( y1, _MM_SHUFFLE( 2, 3, 0, 1 ) ), w1i ) ) ;
+            y2 = _mm256_add_ps( _mm256_mul_ps( y2, w2r ), _mm256_mul_ps( _mm256_permute_ps( y2, _MM_SHUFFLE( 2, 3, 0, 1 ) ), w2i ) ) ;
+            y3 = _mm256_add_ps( _mm256_mul_ps( y3, w3r ), _mm256_mul_ps( _mm256_permute_ps( y3, _MM_SHUFFLE( 2, 3, 0, 1 ) ), w3i ) ) ;
+
+            _mm256_storeu_ps( out,       y0 ) ;
+            _mm256_storeu_ps( out + 2*s, y1 ) ;
+            _mm256_storeu_ps( out + 4*s, y2 ) ;
+            _mm256_storeu_ps( out + 6*s, y3 ) ;
+        }
+    }
+}
+#endif
+
+
+
+
+#ifdef FFT_NEON
+//-----------------------------------------------------------------------------
+// name: fft_stockham4_stage_neon()
+// desc: fft_stockham4_stage_sse2() for NEON
+//-----------------------------------------------------------------------------
+static void fft_stockham4_stage_neon( const float * x, const float * win, float * y, long NC, long n, const float * tw, const float * jsign )
+{
+    const long h = n >> 2 ;
+    const long s = NC / n ;
+    const float * tw1 = tw ;
+    const float * tw2 = tw + 4 * h ;
+    const float * tw3 = tw + 8 * h ;
+    const float32x4_t j = vld1q_f32( jsign ) ;
+    float32x4_t w1r, w1i, w2r, w2i, w3r, w3i ;
+    float32x4_t a, b, c, d, apc, amc, bpd, jbmd, y0, y1, y2, y3 ;
+    long p, q ;
+
+    for( p = 0 ; p < h ; p += ( s == 1 ? 2 : 1 ) )
+    {
+        if( s == 1 )
+        {
+            w1r = vld1q_f32( tw1 + 2*p ) ; w1i = vld1q_f32( tw1 + 2*h + 2*p ) ;
+            w2r = vld1q_f32( tw2 + 2*p ) ; w2i = vld1q_f32( tw2 + 2*h + 2*p ) ;
+            w3r = vld1q_f32( tw3 + 2*p ) ; w3i = vld1q_f32( tw3 + 2*h + 2*p ) ;
+        }
+        else
+        {
+            w1r = vdupq_n_f32( tw1[2*p] ) ;
+            w1i = vcombine_f32( vld1_f32( tw1 + 2*h + 2*p ), vld1_f32( tw1 + 2*h + 2*p ) ) ;
+            w2r = vdupq_n_f32( tw2[2*p] ) ;
+            w2i = vcombine_f32( vld1_f32( tw2 + 2*h + 2*p ), vld1_f32( tw2 + 2*h + 2*p ) ) ;
+            w3r = vdupq_n_f32( tw3[2*p] ) ;
+            w3i = vcombine_f32( vld1_f32( tw3 + 2*h + 2*p ), vld1_f32( tw3 + 2*h + 2*p ) ) ;
+        }
+
+        for( q = 0 ; q < s || q == 0 ; q += 2 )
+        {
+            const float * in = x + ( ( q + s*p ) << 1 ) ;
+            float * out = y + ( ( q + 4*s*p ) << 1 ) ;
+
+            a = vld1q_f32( in ) ;
+            b = vld1q_f32( in + 2*s*h ) ;
+            c = vld1q_f32( in + 4*s*h ) ;
+            d = vld1q_f32( in + 6*s*h ) ;
+            if( win )
+            {
+                const float * wa = win + ( ( q + s*p ) << 1 ) ;
+                a = vmulq_f32( a, vld1q_f32( wa ) ) ;
+                b = vmulq_f32( b, vld1q_f32( wa + 2*s*h ) ) ;
+                c = vmulq_f32( c, vld1q_f32( wa + 4*s*h ) ) ;
+                d = vmulq_f32( d, vld1q_f32( wa + 6*s*h ) ) ;
+            }
+
+            apc = vaddq_f32( a, c ) ;
+            amc = vsubq_f32( a, c ) ;
+            bpd = vaddq_f32( b, d ) ;
+            jbmd = vmulq_f32( vrev64q_f32( vsubq_f32( b, d ) ), j ) ;
+
+            y0 = vaddq_f32( apc, bpd ) ;
+            y1 = vaddq_f32( amc, jbmd ) ;
+            y2 = vsubq_f32( apc, bpd ) ;
+            y3 = vsubq_f32( amc, jbmd ) ;
+            y1 = vmlaq_f32( vmulq_f32( y1, w1r ), vrev64q_f32( y1 ), w1i ) ;
+            y2 = vmlaq_f32( vmulq_f32( y2, w2r ), vrev64q_f32( y2 ), w2i ) ;
+            y3 = vmlaq_f32( vmulq_f32( y3, w3r ), vrev64q_f32( y3 ), w3i ) ;
+
+            if( s == 1 )
+            {
+                vst1q_f32( out,      vcombine_f32( vget_low_f32( y0 ), vget_low_f32( y1 ) ) ) ;
+                vst1q_f32( out + 4,  vcombine_f32( vget_low_f32( y2 ), vget_low_f32( y3 ) ) ) ;
+                vst1q_f32( out + 8,  vcombine_f32( vget_high_f32( y0 ), vget_high_f32( y1 ) ) ) ;
+                vst1q_f32( out + 12, vcombine_f32( vget_high_f32( y2 ), vget_high_f32( y3 ) ) ) ;
+            }
+            else
+            {
+                vst1q_f32( out,       y0 ) ;
+                vst1q_f32( out + 2*s, y1 ) ;
+                vst1q_f32( out + 4*s, y2 ) ;
+                vst1q_f32( out + 6*s, y3 ) ;
+            }
+        }
+    }
+}
+#endif
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_simd_available()
+// desc: true if this build and this CPU can run the given FFT_SIMD_* kernels
+//-----------------------------------------------------------------------------
+int fft_simd_available( int simd )
+{
+#ifdef FFT_X86
+    unsigned int eax, ebx, ecx, edx ;
+  #ifdef _MSC_VER
+    int info[4] ;
+  #endif
+#endif
+
+    switch( simd )
+    {
+    case FFT_SIMD_NONE:
+        return 1 ;
+#ifdef FFT_X86
+    case FFT_SIMD_SSE2:
+  #if defined( __x86_64__ ) || defined( _M_X64 )
+        // part of x86-64
+        return 1 ;
+  #else
+    #ifdef _MSC_VER
+        __cpuid( info, 1 ) ; edx = (unsigned int)info[3] ;
+    #else
+        if( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) ) return 0 ;
+    #endif
+        return ( edx >> 26 ) & 1 ;
+  #endif
+    case FFT_SIMD_AVX2:
+  #ifdef _MSC_VER
+        __cpuid( info, 0 ) ;
+        if( info[0] < 7 ) return 0 ;
+        __cpuid( info, 1 ) ; ecx = (unsigned int)info[2] ;
+        __cpuidex( info, 7, 0 ) ; ebx = (unsigned int)info[1] ;
+  #else
+        if( __get_cpuid_max( 0, NULL ) < 7 ) return 0 ;
+        __cpuid( 1, eax, ebx, ecx, edx ) ;
+        {
+            // only the OSXSAVE bit of leaf 1 is needed; leaf 7 overwrites ebx
+            unsigned int ecx1 = ecx ;
+            __cpuid_count( 7, 0, eax, ebx, ecx, edx ) ;
+            ecx = ecx1 ;
+        }
+  #endif
+        // the CPU has AVX2 and the OS saves the ymm registers (OSXSAVE, then XCR0 bits 1 and 2)
+        if( !( ( ebx >> 5 ) & 1 ) || !( ( ecx >> 27 ) & 1 ) )
+            return 0 ;
+  #ifdef _MSC_VER
+        return ( _xgetbv( 0 ) & 6 ) == 6 ;
+  #else
+        __asm__( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ) ) ;
+        return ( eax & 6 ) == 6 ;
+  #endif
+#endif
+#ifdef FFT_NEON
+    case FFT_SIMD_NEON:
+        // every CPU we build NEON code for has it
+        return 1 ;
+#endif
+    default:
+        return 0 ;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_simd_name()
+// desc: printable name of an FFT_SIMD_* value
+//-----------------------------------------------------------------------------
+const char * fft_simd_name( int simd )
+{
+    switch( simd )
+    {
+    case FFT_SIMD_NONE: return "scalar" ;
+    case FFT_SIMD_SSE2: return "sse2" ;
+    case FFT_SIMD_AVX2: return "avx2" ;
+    case FFT_SIMD_NEON: return "neon" ;
+    default: return "best" ;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stage_for()
+// desc: widest kernel of the given instruction set that can run a stage
+//       combining transforms of h points
+//-----------------------------------------------------------------------------
+static fft_stage_function fft_stage_for( int simd, long h )
+{
+#ifdef FFT_X86
+    if( simd == FFT_SIMD_AVX2 && h >= 4 )
+        return fft_radix4_stage_avx2 ;
+    if( ( simd == FFT_SIMD_AVX2 || simd == FFT_SIMD_SSE2 ) && h >= 2 )
+        return fft_radix4_stage_sse2 ;
+#endif
+#ifdef FFT_NEON
+    if( simd == FFT_SIMD_NEON && h >= 2 )
+        return fft_radix4_stage_neon ;
+#endif
+    return fft_radix4_stage_scalar ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stockham_for()
+// desc: widest stockham kernel of the given instruction set that can split
+//       transforms of n points
+//-----------------------------------------------------------------------------
+static fft_stockham_function fft_stockham_for( int simd, long NC, long n )
+{
+    // the kernels work along q, two or four transforms at a time, except
+    // in the first stage (s = 1), where they work along p two at a time
+    long s = NC / n ;
+    if( s == 1 ? ( n >> 2 ) & 1 : s & 1 )
+        return fft_stockham4_stage_scalar ;
+#ifdef FFT_X86
+    if( simd == FFT_SIMD_AVX2 && ( s & 3 ) == 0 )
+        return fft_stockham4_stage_avx2 ;
+    if( simd == FFT_SIMD_AVX2 || simd == FFT_SIMD_SSE2 )
+        return fft_stockham4_stage_sse2 ;
+#endif
+#ifdef FFT_NEON
+    if( simd == FFT_SIMD_NEON )
+        return fft_stockham4_stage_neon ;
+#endif
+    return fft_stockham4_stage_scalar ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_size_supported()
+// desc: true if NC is a product of 2s, 3s and 5s
+//-----------------------------------------------------------------------------
+int fft_size_supported( long NC )
+{
+    if( NC < 1 )
+        return 0 ;
+    while( NC % 2 == 0 ) NC /= 2 ;
+    while( NC % 3 == 0 ) NC /= 3 ;
+    while( NC % 5 == 0 ) NC /= 5 ;
+    return NC == 1 ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_create()
+// desc: allocate and fill the tables for NC complex points, using the
+//       fastest kernels this CPU supports
+//-----------------------------------------------------------------------------
+fft_plan * fft_plan_create( long NC )
+{
+    return fft_plan_create_simd( NC, FFT_SIMD_BEST ) ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_create_simd()
+// desc: fft_plan_create() with the instruction set chosen by the caller
+//       (e.g. to compare kernels); returns NULL if it isn't available
+//-----------------------------------------------------------------------------
+fft_plan * fft_plan_create_simd( long NC, int simd )
+{
+    fft_plan * plan ;
+    long h, k, i, j, m, s, r, count, twiddle_count ;
+    long factors[3] ;
+    const long radices[3] = { 3, 5, 4 } ;
+
+    if( !fft_size_supported( NC ) )
+        return NULL ;
+
+    if( simd == FFT_SIMD_BEST )
+    {
+        if( fft_simd_available( FFT_SIMD_AVX2 ) ) simd = FFT_SIMD_AVX2 ;
+        else if( fft_simd_available( FFT_SIMD_SSE2 ) ) simd = FFT_SIMD_SSE2 ;
+        else if( fft_simd_available( FFT_SIMD_NEON ) ) simd = FFT_SIMD_NEON ;
+        else simd = FFT_SIMD_NONE ;
+    }
+    else if( !fft_simd_available( simd ) )
+        return NULL ;
+
+    plan = (fft_plan *)calloc( 1, sizeof( fft_plan ) ) ;
+    if( !plan )
+        return NULL ;
+    plan->NC = NC ;
+    plan->simd = simd ;
+
+    // count the 3s, 5s and pairs of 2s in NC; an odd number of 2s leaves
+    // one radix-2 stage, which goes first
+    for( h = NC, factors[2] = 0 ; h % 2 == 0 ; h /= 2 )
+        factors[2]++ ;
+    for( factors[0] = 0 ; h % 3 == 0 ; h /= 3 )
+        factors[0]++ ;
+    for( factors[1] = 0 ; h % 5 == 0 ; h /= 5 )
+        factors[1]++ ;
+    plan->radix2_first = factors[2] & 1 ;
+    factors[2] >>= 1 ;
+    plan->power_of_2 = ( factors[0] == 0 && factors[1] == 0 ) ;
+
+    // then the radix-3 and radix-5 stages, and the radix-4 stages last, on
+    // the biggest transforms, where the stockham kernels can use SIMD
+    twiddle_count = 0 ;
+    h = plan->radix2_first ? 2 : 1 ;
+    for( r = 0 ; r < 3 ; r++ )
+    {
+        for( i = 0 ; i < factors[r] ; i++ )
+        {
+            s = plan->stage_count++ ;
+            plan->stage_radix[s] = radices[r] ;
+            plan->stage_h[s] = h ;
+            plan->stage_offset[s] = twiddle_count ;
+            if( radices[r] == 4 )
+            {
+                plan->stage_function[s] = plan->power_of_2 ? fft_stage_for( simd, h ) : NULL ;
+                plan->stockham_function[s] = fft_stockham_for( simd, NC, 4 * h ) ;
+            }
+            else
+                plan->stockham_function[s] = radices[r] == 3 ? fft_stockham3_stage_scalar : fft_stockham5_stage_scalar ;
+            twiddle_count += ( radices[r] - 1 ) * 4 * h ;
+            h *= radices[r] ;
+        }
+    }
+
+    plan->twiddles = (float *)malloc( sizeof( float ) * ( twiddle_count + 1 ) ) ;
+    plan->inverse_twiddles = (float *)malloc( sizeof( float ) * ( twiddle_count + 1 ) ) ;
+    plan->real_twiddles = (complex *)malloc( sizeof( complex ) * (NC/2 + 1) ) ;
+    // every index takes part in at most one swap
+    plan->swaps = (long *)malloc( sizeof( long ) * NC ) ;
+    if( !plan->twiddles || !plan->inverse_twiddles || !plan->real_twiddles || !plan->swaps )
+    {
+        fft_plan_destroy( plan ) ;
+        return NULL ;
+    }
+
+    for( i = FFT_WINDOW_NONE + 1 ; i < FFT_WINDOW_COUNT ; i++ )
+    {
+        plan->windows[i] = (float *)malloc( sizeof( float ) * ( NC << 1 ) ) ;
+        if( !plan->windows[i] )
+        {
+            fft_plan_destroy( plan ) ;
+            return NULL ;
+        }
+        fft_window_fill( plan->windows[i], NC << 1, (int)i ) ;
+    }
+
+    for( s = 0 ; s < plan->stage_count ; s++ )
+    {
+        fft_stage_twiddles( plan->twiddles + plan->stage_offset[s], plan->stage_h[s], plan->stage_radix[s], 1. ) ;
+        fft_stage_twiddles( plan->inverse_twiddles + plan->stage_offset[s], plan->stage_h[s], plan->stage_radix[s], -1. ) ;
+    }
+
+    for( k = 0 ; k <= NC/2 ; k++ )
+    {
+        plan->real_twiddles[k].re = (float)cos( FFT_PI * k / NC ) ;
+        plan->real_twiddles[k].im = (float)sin( FFT_PI * k / NC ) ;
+    }
+
+    // same walk as bit_reverse(), in complex indices
+    count = 0 ;
+    for( i = j = 0 ; plan->power_of_2 && i < NC ; i++, j += m )
+    {
+        if( j > i )
+        {
+            plan->swaps[count++] = i ;
+            plan->swaps[count++] = j ;
+        }
+
+        for( m = NC>>1 ; m >= 1 && j >= m ; m >>= 1 )
+            j -= m ;
+    }
+    plan->swap_count = count / 2 ;
+
+    return plan ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_destroy()
+// desc: free a plan from fft_plan_create(); NULL is ignored
+//-----------------------------------------------------------------------------
+void fft_plan_destroy( fft_plan * plan )
+{
+    int i ;
+
+    if( !plan )
+        return ;
+    for( i = 0 ; i < FFT_WINDOW_COUNT ; i++ )
+        free( plan->windows[i] ) ;
+    free( plan->twiddles ) ;
+    free( plan->inverse_twiddles ) ;
+    free( plan->real_twiddles ) ;
+    free( plan->swaps ) ;
+    free( plan ) ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_size()
+// desc: number of complex points the plan transforms
+//-----------------------------------------------------------------------------
+long fft_plan_size( const fft_plan * plan )
+{
+    return plan->NC ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_simd()
+// desc: instruction set (FFT_SIMD_*) the plan's kernels use
+//-----------------------------------------------------------------------------
+int fft_plan_simd( const fft_plan * plan )
+{
+    return plan->simd ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_window()
+// desc: the plan's table for one of the FFT_WINDOW_* windows
+//-----------------------------------------------------------------------------
+const float * fft_plan_window( const fft_plan * plan, int type )
+{
+    if( type <= FFT_WINDOW_NONE || type >= FFT_WINDOW_COUNT )
+        return NULL ;
+    return plan->windows[type] ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rfft_untangle()
+// desc: the part of rfft() around its complex fft: after it (forward),
+//       separates the spectrum of the even and odd samples into that of
+//       the 2*NC real values; before it (inverse), combines them again
+//-----------------------------------------------------------------------------
+static void rfft_untangle( const fft_plan * plan, float * x, unsigned int forward )
+{
+    float c1, c2, h1r, h1i, h2r, h2i, wr, wi ;
+    float xr, xi ;
+    long i, i1, i2, i3, i4, N, N2p1 ;
+    const complex * w = plan->real_twiddles ;
+    // the inverse walks the same angles in the other direction
+    float sign ;
+
+    N = plan->NC ;
+    c1 = 0.5 ;
+
+    if( forward )
+    {
+        c2 = -0.5 ;
+        sign = 1. ;
+        xr = x[0] ;
+        xi = x[1] ;
+    }
+    else
+    {
+        c2 = 0.5 ;
+        sign = -1. ;
+        xr = x[1] ;
+        xi = 0. ;
+        x[1] = 0. ;
+    }
+
+    N2p1 = (N<<1) + 1 ;
+
+    for( i = 0 ; i <= N>>1 ; i++ )
+    {
+        i1 = i<<1 ;
+        i2 = i1 + 1 ;
+        i3 = N2p1 - i2 ;
+        i4 = i3 + 1 ;
+        wr = w[i].re ;
+        wi = sign * w[i].im ;
+        if( i == 0 )
+        {
+            h1r =  c1*(x[i1] + xr ) ;
+            h1i =  c1*(x[i2] - xi ) ;
+            h2r = -c2*(x[i2] + xi ) ;
+            h2i =  c2*(x[i1] - xr ) ;
+            x[i1] =  h1r + wr*h2r - wi*h2i ;
+            x[i2] =  h1i + wr*h2i + wi*h2r ;
+            xr =  h1r - wr*h2r + wi*h2i ;
+            xi = -h1i + wr*h2i + wi*h2r ;
+        }
+        else
+        {
+            h1r =  c1*(x[i1] + x[i3] ) ;
+            h1i =  c1*(x[i2] - x[i4] ) ;
+            h2r = -c2*(x[i2] + x[i4] ) ;
+            h2i =  c2*(x[i1] - x[i3] ) ;
+            x[i1] =  h1r + wr*h2r - wi*h2i ;
+            x[i2] =  h1i + wr*h2i + wi*h2r ;
+            x[i3] =  h1r - wr*h2r + wi*h2i ;
+            x[i4] = -h1i + wr*h2i + wi*h2r ;
+        }
+    }
+
+    if( forward )
+        x[1] = xr ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_in_place()
+// desc: true if the plan has in-place stages, i.e. NC is a power of 2
+//-----------------------------------------------------------------------------
+int fft_plan_in_place( const fft_plan * plan )
+{
+    return plan->power_of_2 ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rfft_with_plan()
+// desc: rfft() on 2*NC real values, with every twiddle from the plan
+//-----------------------------------------------------------------------------
+int rfft_with_plan( const fft_plan * plan, float * x, unsigned int forward )
+{
+    if( !plan->power_of_2 )
+        return 0 ;
+
+    if( forward )
+    {
+        cfft_with_plan( plan, x, forward ) ;
+        rfft_untangle( plan, x, forward ) ;
+    }
+    else
+    {
+        rfft_untangle( plan, x, forward ) ;
+        cfft_with_plan( plan, x, forward ) ;
+    }
+    return 1 ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rfft_stockham()
+// desc: rfft_with_plan() from in to out, with cfft_stockham() in the middle
+//-----------------------------------------------------------------------------
+void rfft_stockham( const fft_plan * plan, const float * in, float * out, float * work, unsigned int forward )
+{
+    if( forward )
+    {
+        cfft_stockham( plan, in, out, work, forward ) ;
+        rfft_untangle( plan, out, forward ) ;
+    }
+    else
+    {
+        // untangle a copy, so in is left alone
+        if( in != work )
+            memcpy( work, in, sizeof( float ) * ( plan->NC << 1 ) ) ;
+        rfft_untangle( plan, work, forward ) ;
+        cfft_stockham( plan, work, out, work, forward ) ;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rfft_stockham_windowed()
+// desc: forward rfft_stockham() of in times window, with the multiply done
+//       by the first stage as it reads in
+//-----------------------------------------------------------------------------
+void rfft_stockham_windowed( const fft_plan * plan, const float * in, const float * window, float * out, float * work )
+{
+    fft_stockham_run( plan, in, window, out, work, FFT_FORWARD ) ;
+    rfft_untangle( plan, out, FFT_FORWARD ) ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cfft_with_plan()
+// desc: cfft() on NC complex values: the plan's bit-reversal swaps, then
+//       its radix-2 and radix-4 stages
+//-----------------------------------------------------------------------------
+int cfft_with_plan( const fft_plan * plan, float * x, unsigned int forward )
+{
+    const float * twiddles = forward ? plan->twiddles : plan->inverse_twiddles ;
+    const float * jsign = forward ? fft_forward_jsign : fft_inverse_jsign ;
+    float rtemp, itemp, scale ;
+    long i, j, s, NC ;
+
+    NC = plan->NC ;
+
+    // mixed-radix sizes have no in-place stages, and the plan can't lend
+    // scratch space to several threads at once: leave x alone and let the
+    // caller use cfft_stockham() with work of its own
+    if( !plan->power_of_2 )
+        return 0 ;
+
+    for( s = 0 ; s < plan->swap_count ; s++ )
+    {
+        i = plan->swaps[2*s] << 1 ;
+        j = plan->swaps[2*s + 1] << 1 ;
+        rtemp = x[j] ; itemp = x[j+1] ; /* complex exchange */
+        x[j] = x[i] ; x[j+1] = x[i+1] ;
+        x[i] = rtemp ; x[i+1] = itemp ;
+    }
+
+    // length-2 transforms need no twiddles
+    if( plan->radix2_first )
+    {
+        for( i = 0 ; i < NC<<1 ; i += 4 )
+        {
+            rtemp = x[i+2] ; itemp = x[i+3] ;
+            x[i+2] = x[i] - rtemp ; x[i+3] = x[i+1] - itemp ;
+            x[i] += rtemp ; x[i+1] += itemp ;
+        }
+    }
+
+    for( s = 0 ; s < plan->stage_count ; s++ )
+        plan->stage_function[s]( x, NC, plan->stage_h[s], twiddles + plan->stage_offset[s], jsign ) ;
+
+    // scale output, same as cfft()
+    scale = (float)(forward ? 1./(NC<<1) : 2.) ;
+    for( i = 0 ; i < NC<<1 ; i++ )
+        x[i] *= scale ;
+    return 1 ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cfft_stockham()
+// desc: cfft_with_plan() out of place and without the bit-reversal pass
+//-----------------------------------------------------------------------------
+void cfft_stockham( const fft_plan * plan, const float * in, float * out, float * work, unsigned int forward )
+{
+    fft_stockham_run( plan, in, NULL, out, work, forward ) ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_stockham_run()
+// desc: cfft_stockham() of in times window (2*NC floats, or NULL): the
+//       stockham stages ping-pong between out and work, starting with
+//       whichever one makes the last stage land in out, and the first one
+//       applies the window
+//-----------------------------------------------------------------------------
+static void fft_stockham_run( const fft_plan * plan, const float * in, const float * window,
+                              float * out, float * work, unsigned int forward )
+{
+    const float * twiddles = forward ? plan->twiddles : plan->inverse_twiddles ;
+    const float * jsign = forward ? fft_forward_jsign : fft_inverse_jsign ;
+    const float * src = in ;
+    float * dst ;
+    float scale ;
+    long i, s, NC ;
+
+    NC = plan->NC ;
+
+    // an odd number of stages starts in out, an even number in work
+    dst = ( ( plan->stage_count + plan->radix2_first ) & 1 ) ? out : work ;
+    if( dst == in || plan->stage_count + plan->radix2_first == 0 )
+    {
+        // in is where the first stage has to write (or there are no
+        // stages), so start from a copy in the other buffer, windowed on
+        // the way since the copy is a pass over in anyway
+        float * copy = ( dst == out ) ? work : out ;
+        if( window )
+        {
+            for( i = 0 ; i < NC<<1 ; i++ )
+                copy[i] = in[i] * window[i] ;
+            window = NULL ;
+        }
+        else if( copy != in )
+            memcpy( copy, in, sizeof( float ) * ( NC << 1 ) ) ;
+        src = copy ;
+    }
+
+    for( s = plan->stage_count - 1 ; s >= 0 ; s-- )
+    {
+        plan->stockham_function[s]( src, window, dst, NC, plan->stage_h[s] * plan->stage_radix[s], twiddles + plan->stage_offset[s], jsign ) ;
+        window = NULL ;
+        src = dst ;
+        dst = ( dst == out ) ? work : out ;
+    }
+    if( plan->radix2_first )
+        fft_stockham2_stage( src, window, dst, NC ) ;
+
+    // scale output, same as cfft()
+    scale = (float)(forward ? 1./(NC<<1) : 2.) ;
+    for( i = 0 ; i < NC<<1 ; i++ )
+        out[i] *= scale ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_batch_work_size()
+// desc: floats of scratch space rfft_batch() and cfft_batch() need
+//-----------------------------------------------------------------------------
+long fft_batch_work_size( const fft_plan * plan )
+{
+    // the same work the stockham transforms take, reused for every frame
+    return 2 * plan->NC ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rfft_batch()
+// desc: rfft_stockham() on count frames
+//-----------------------------------------------------------------------------
+void rfft_batch( const fft_plan * plan, const float * in, long in_stride,
+                 float * out, long out_stride, long count, float * work, unsigned int forward )
+{
+    long f ;
+
+    for( f = 0 ; f < count ; f++ )
+        rfft_stockham( plan, in + in_stride*f, out + out_stride*f, work, forward ) ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cfft_batch()
+// desc: cfft_stockham() on count frames
+//-----------------------------------------------------------------------------
+void cfft_batch( const fft_plan * plan, const float * in, long in_stride,
+                 float * out, long out_stride, long count, float * work, unsigned int forward )
+{
+    long f ;
+
+    for( f = 0 ; f < count ; f++ )
+        cfft_stockham( plan, in + in_stride*f, out + out_stride*f, work, forward ) ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rfft_batch_windowed()
+// desc: rfft_stockham_windowed() on count frames
+//-----------------------------------------------------------------------------
+void rfft_batch_windowed( const fft_plan * plan, const float * in, long in_stride, const float * window,
+                          float * out, long out_stride, long count, float * work )
+{
+    long f ;
+
+    for( f = 0 ; f < count ; f++ )
+        rfft_stockham_windowed( plan, in + in_stride*f, window, out + out_stride*f, work ) ;
+}
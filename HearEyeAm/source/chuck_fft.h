@@ -20,6 +20,20 @@ typedef struct { float re ; float im ; } complex;
 #define FFT_FORWARD 1
 #define FFT_INVERSE 0
 
+// instruction sets for fft plans
+#define FFT_SIMD_BEST -1
+#define FFT_SIMD_NONE 0
+#define FFT_SIMD_SSE2 1
+#define FFT_SIMD_AVX2 2
+#define FFT_SIMD_NEON 3
+
+// windows for fft_window_fill and fft_plan_window
+#define FFT_WINDOW_NONE     0
+#define FFT_WINDOW_HANNING  1
+#define FFT_WINDOW_HAMMING  2
+#define FFT_WINDOW_BLACKMAN 3
+#define FFT_WINDOW_COUNT    4
+
 // c linkage
 #if ( defined( __cplusplus ) || defined( _cplusplus ) )
   extern "C" {
@@ -29,14 +43,81 @@ typedef struct { float re ; float im ; } complex;
 void hanning( float * window, unsigned long length );
 void hamming( float * window, unsigned long length );
 void blackman( float * window, unsigned long length );
+// make any FFT_WINDOW_* window (FFT_WINDOW_NONE is all ones)
+void fft_window_fill( float * window, unsigned long length, int type );
 // apply the window
 void apply_window( float * data, float * window, unsigned long length );
 
+// everything below is reentrant: nothing is kept between calls except in
+// caller-owned fft_plans, so transforms can run on any number of threads
+
 // real fft, N must be power of 2
 void rfft( float * x, long N, unsigned int forward );
 // complex fft, NC must be power of 2
 void cfft( float * x, long NC, unsigned int forward );
 
+// precomputed tables for one transform size; create once, use from any
+// number of threads at the same time, destroy when done
+typedef struct fft_plan fft_plan;
+// plan for NC complex points (or 2*NC real points). NC must be a product
+// of 2s, 3s and 5s (e.g. 240, for 480-frame blocks); radix-3 and radix-5
+// stages are scalar, so powers of 2 are fastest. uses the fastest SIMD
+// kernels the CPU has; returns NULL if NC isn't supported or allocation
+// fails
+fft_plan * fft_plan_create( long NC );
+// same, with the instruction set given as one of the FFT_SIMD_* values
+// below; returns NULL if this build or CPU can't run it
+fft_plan * fft_plan_create_simd( long NC, int simd );
+void fft_plan_destroy( fft_plan * plan );
+// NC the plan was created for
+long fft_plan_size( const fft_plan * plan );
+// instruction set the plan uses (never FFT_SIMD_BEST)
+int fft_plan_simd( const fft_plan * plan );
+// the plan's 2*NC-point table for one of the FFT_WINDOW_* windows, made
+// with the plan; NULL for FFT_WINDOW_NONE (which the windowed transforms
+// below take to mean no window)
+const float * fft_plan_window( const fft_plan * plan, int type );
+// true if fft_plan_create() takes NC
+int fft_size_supported( long NC );
+// true if this build and CPU can run the given instruction set
+int fft_simd_available( int simd );
+// "scalar", "sse2", ...
+const char * fft_simd_name( int simd );
+// true if the in-place transforms below take the plan: NC is a power of 2
+int fft_plan_in_place( const fft_plan * plan );
+// same as rfft( x, fft_plan_size( plan ), forward ), using the plan's tables
+int rfft_with_plan( const fft_plan * plan, float * x, unsigned int forward );
+// same as cfft( x, fft_plan_size( plan ), forward ), using the plan's tables
+int cfft_with_plan( const fft_plan * plan, float * x, unsigned int forward );
+// (these two only run in place for powers of 2. for other sizes they
+// return 0 and leave x untouched; use the stockham versions below, whose
+// scratch space is the caller's. they return 1 otherwise)
+// self-sorting (stockham) versions: transform in into out without a
+// bit-reversal pass, using work (same size as out) as scratch. out and work
+// must not overlap; in may be out or work (costing one extra copy), and is
+// otherwise left untouched
+void rfft_stockham( const fft_plan * plan, const float * in, float * out, float * work, unsigned int forward );
+void cfft_stockham( const fft_plan * plan, const float * in, float * out, float * work, unsigned int forward );
+// forward rfft_stockham() of in multiplied by window (2*NC floats, e.g.
+// from fft_plan_window(), or NULL). the first stage multiplies as it reads
+// in, so windowing doesn't cost a pass over memory of its own
+void rfft_stockham_windowed( const fft_plan * plan, const float * in, const float * window, float * out, float * work );
+// batches of count same-size transforms: frame f is read from
+// in + f*in_stride and written to out + f*out_stride (strides in floats),
+// one stockham transform at a time (interleaving frames across the SIMD
+// lanes measured slower: the single-frame kernels already fill them, and
+// interleaving costs two extra passes over memory). work needs
+// fft_batch_work_size( plan ) floats; in and out may be the same buffer
+// with the same stride
+long fft_batch_work_size( const fft_plan * plan );
+void rfft_batch( const fft_plan * plan, const float * in, long in_stride,
+                 float * out, long out_stride, long count, float * work, unsigned int forward );
+void cfft_batch( const fft_plan * plan, const float * in, long in_stride,
+                 float * out, long out_stride, long count, float * work, unsigned int forward );
+// rfft_stockham_windowed() on count frames
+void rfft_batch_windowed( const fft_plan * plan, const float * in, long in_stride, const float * window,
+                          float * out, long out_stride, long count, float * work );
+
 // c linkage
 #if ( defined( __cplusplus ) || defined( _cplusplus ) )
   }